@@ -0,0 +1,203 @@
+//
+//  gentree.c
+//  PA01_FindDups
+//
+//  Builds a reproducible synthetic tree for the benchmarks. Every file's
+//  contents come from a seed, so the same options always give the same
+//  tree. A fraction of the files are exact copies of an earlier file,
+//  near-copies (same size and head, last bytes changed, so they survive the
+//  size and head stages), or hardlinks to one. A near-copy's last bytes are
+//  XORed with a variant number counted per original, so it differs from
+//  the original, from the file it was made from and from every other
+//  near-copy of the same original.
+//
+//  Sizes are log-uniform between the minimum and maximum, which gives the
+//  many-small, few-large mix of a real file system. Files are spread over
+//  a tree FANOUT wide and DEPTH deep.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <limits.h> // for PATH_MAX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define WRITE_CHUNK (1024 * 1024)
+
+typedef struct {
+    long files;
+    uint64_t min_size, max_size;
+    double dup_ratio, near_ratio, link_ratio;
+    int depth, fanout;
+    uint64_t seed;
+} Options;
+
+// xorshift64*: fast, and the same on every platform
+static uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static double random_unit(uint64_t* state) {
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void usage(const char* progname) {
+    fprintf(stderr, "usage: %s [-n files] [-s min-bytes] [-S max-bytes] [-d dup-ratio]\n"
+                    "       [-N near-dup-ratio] [-l link-ratio] [-D depth] [-F fanout] [-r seed] dir\n",
+            progname);
+    exit(EXIT_FAILURE);
+}
+
+// Path of file `i`: its leaf directory is picked from i, one level per digit
+static void file_path(const Options* opt, const char* root, long i, char* buf, size_t len, int mkdirs) {
+    int n = snprintf(buf, len, "%s", root);
+    uint64_t leaf = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+    for (int d = 0; d < opt->depth; d++) {
+        n += snprintf(buf + n, len - n, "/d%d", (int)(leaf % opt->fanout));
+        leaf /= opt->fanout;
+        if (mkdirs && mkdir(buf, 0755) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Cannot create directory %s: %s\n", buf, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    snprintf(buf + n, len - n, "/f%ld", i);
+}
+
+// Writes `size` bytes generated from `seed`, with the last (up to 8) bytes
+// XORed with `variant`, lowest byte last
+static void write_file(const char* path, uint64_t size, uint64_t seed, uint64_t variant,
+                       unsigned char* buf) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create file %s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    uint64_t state = seed | 1;
+    for (uint64_t done = 0; done < size;) {
+        size_t want = size - done < WRITE_CHUNK ? size - done : WRITE_CHUNK;
+        for (size_t i = 0; i < want; i += 8) {
+            uint64_t r = next_random(&state);
+            memcpy(buf + i, &r, want - i < 8 ? want - i : 8);
+        }
+        uint64_t tail = size < 8 ? 0 : size - 8; // First byte the variant reaches
+        for (uint64_t at = tail > done ? tail : done; at < done + want; at++) {
+            buf[at - done] ^= (unsigned char)(variant >> (8 * (size - 1 - at)));
+        }
+        if (write(fd, buf, want) != (ssize_t)want) {
+            fprintf(stderr, "Cannot write file %s: %s\n", path, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        done += want;
+    }
+    close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    Options opt = { 10000, 1, 1 << 20, 0.2, 0.05, 0.02, 3, 16, 1 };
+    int ch;
+    while ((ch = getopt(argc, argv, "n:s:S:d:N:l:D:F:r:")) != -1) {
+        switch (ch) {
+        case 'n': opt.files = atol(optarg); break;
+        case 's': opt.min_size = strtoull(optarg, NULL, 10); break;
+        case 'S': opt.max_size = strtoull(optarg, NULL, 10); break;
+        case 'd': opt.dup_ratio = atof(optarg); break;
+        case 'N': opt.near_ratio = atof(optarg); break;
+        case 'l': opt.link_ratio = atof(optarg); break;
+        case 'D': opt.depth = atoi(optarg); break;
+        case 'F': opt.fanout = atoi(optarg); break;
+        case 'r': opt.seed = strtoull(optarg, NULL, 10); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || opt.files < 1 || opt.min_size < 1 || opt.max_size < opt.min_size ||
+        opt.depth < 0 || opt.fanout < 1 || opt.dup_ratio + opt.near_ratio + opt.link_ratio > 1) {
+        usage(argv[0]);
+    }
+    const char* root = argv[optind];
+    if (mkdir(root, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Cannot create directory %s: %s\n", root, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // Seed, size and variant of every file, so copies can match their
+    // original exactly; the original each file derives from, and how many
+    // near-copies each original has
+    uint64_t* seeds = malloc(sizeof(uint64_t) * opt.files);
+    uint64_t* sizes = malloc(sizeof(uint64_t) * opt.files);
+    uint64_t* variants = malloc(sizeof(uint64_t) * opt.files);
+    long* roots = malloc(sizeof(long) * opt.files);
+    uint64_t* near_count = calloc(opt.files, sizeof(uint64_t));
+    unsigned char* buf = malloc(WRITE_CHUNK);
+    if (!seeds || !sizes || !variants || !roots || !near_count || !buf) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t state = opt.seed * 0x9E3779B97F4A7C15ULL + 1;
+    double span = log((double)opt.max_size / opt.min_size);
+    char path[PATH_MAX], orig[PATH_MAX];
+    long copies = 0, nears = 0, links = 0;
+    unsigned long long bytes = 0;
+
+    for (long i = 0; i < opt.files; i++) {
+        file_path(&opt, root, i, path, sizeof(path), 1);
+        double kind = random_unit(&state);
+        long src = i > 0 ? (long)(next_random(&state) % i) : -1;
+
+        if (src >= 0 && kind < opt.link_ratio) {
+            file_path(&opt, root, src, orig, sizeof(orig), 0);
+            if (link(orig, path) == 0) {
+                seeds[i] = seeds[src];
+                sizes[i] = sizes[src];
+                variants[i] = variants[src];
+                roots[i] = roots[src];
+                links++;
+                continue;
+            }
+            // Linking failed (e.g. the original was itself a link on
+            // another file system): write a copy instead
+        }
+
+        if (src >= 0 && kind < opt.link_ratio + opt.dup_ratio) {
+            seeds[i] = seeds[src];
+            sizes[i] = sizes[src];
+            variants[i] = variants[src];
+            roots[i] = roots[src];
+            copies++;
+        } else if (src >= 0 && kind < opt.link_ratio + opt.dup_ratio + opt.near_ratio) {
+            // Counted from the original, not from `src`, which may itself
+            // be a near-copy
+            roots[i] = roots[src];
+            seeds[i] = seeds[src];
+            sizes[i] = sizes[src];
+            variants[i] = ++near_count[roots[i]];
+            nears++;
+        } else {
+            seeds[i] = next_random(&state);
+            sizes[i] = (uint64_t)(opt.min_size * exp(random_unit(&state) * span));
+            variants[i] = 0;
+            roots[i] = i;
+        }
+        write_file(path, sizes[i], seeds[i], variants[i], buf);
+        bytes += sizes[i];
+    }
+
+    fprintf(stderr, "%ld files (%ld copies, %ld near-copies, %ld hardlinks), %llu bytes in %s\n",
+            opt.files, copies, nears, links, bytes, root);
+    free(seeds);
+    free(sizes);
+    free(variants);
+    free(roots);
+    free(near_count);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,45 @@
+#!/bin/bash
+#
+#  hash_bench.sh
+#  PA01_FindDups
+#
+#  Compares digest backends on two identical SIZE_MB files. Both files
+#  are read once beforehand so the page cache holds them and the numbers
+#  reflect hashing speed rather than the disk. --verify rows add the
+#  byte-compare pass on top of hashing. --lockstep=0 keeps the pair from
+#  being byte-compared instead of hashed, and a run that reports no fully
+#  hashed files fails the script rather than timing read() and memcmp().
+#
+#  usage: bench/hash_bench.sh [dir] [size-MiB]
+#
+
+FINDDUPS=${FINDDUPS:-./finddups}
+DIR=${1:-/tmp/finddups_hash_bench}
+SIZE_MB=${2:-1024}
+
+mkdir -p "$DIR" || exit 1
+if [ ! -f "$DIR/a" ] || [ "$(stat -c %s "$DIR/a")" -ne $((SIZE_MB * 1024 * 1024)) ]; then
+    head -c $((SIZE_MB * 1024 * 1024)) /dev/urandom > "$DIR/a" || exit 1
+    cp "$DIR/a" "$DIR/b" || exit 1
+fi
+cat "$DIR/a" "$DIR/b" > /dev/null
+
+STATS=$(mktemp) || exit 1
+trap 'rm -f "$STATS"' EXIT
+
+echo "hash,options,seconds,MB/s"
+for hash in sha256 blake2b xxh64; do
+    for opts in "" "--verify"; do
+        start=$(date +%s%N)
+        "$FINDDUPS" -p 0 --lockstep=0 --keep-cache --stats --hash=$hash $opts "$DIR" \
+            > /dev/null 2> "$STATS"
+        end=$(date +%s%N)
+        hashed=$(awk '/^fully hashed:/ { print $3 }' "$STATS")
+        if [ "${hashed:-0}" -eq 0 ]; then
+            echo "$hash $opts: no files were fully hashed" >&2
+            exit 1
+        fi
+        ms=$(((end - start) / 1000000))
+        echo "$hash,$opts,$((ms / 1000)).$(printf %03d $((ms % 1000))),$((2 * SIZE_MB * 1000 / (ms > 0 ? ms : 1)))"
+    done
+done
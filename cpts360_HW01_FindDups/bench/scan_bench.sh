@@ -0,0 +1,60 @@
+#!/bin/bash
+#
+#  scan_bench.sh
+#  PA01_FindDups
+#
+#  Runs the whole pipeline over a synthetic tree from bench/gentree at
+#  several thread counts and in several modes, and writes one CSV row per
+#  run. files/s counts every file the walk found; MB/s counts the file
+#  data read for hashing and comparing, both over the run's wall time. The
+#  tree is read once first so every row runs against a warm page cache.
+#
+#  GENTREE_ARGS is passed to the generator (see bench/gentree.c for the
+#  options); delete the tree to regenerate it with different ones.
+#
+#  usage: bench/scan_bench.sh [tree-dir] [thread counts...] > results.csv
+#
+
+FINDDUPS=${FINDDUPS:-./finddups}
+GENTREE=${GENTREE:-./bench/gentree}
+TREE=${1:-/tmp/finddups_scan_tree}
+shift 2>/dev/null
+THREADS=${*:-"1 2 4 8"}
+GENTREE_ARGS=${GENTREE_ARGS:-"-n 100000 -s 1 -S 4194304 -d 0.2 -N 0.05 -l 0.02 -D 3 -F 16"}
+SPILL=${SPILL:-/tmp/finddups_scan_spill}
+
+if [ ! -d "$TREE" ]; then
+    echo "building $TREE ($GENTREE_ARGS)..." >&2
+    "$GENTREE" $GENTREE_ARGS "$TREE" || exit 1
+fi
+mkdir -p "$SPILL" || exit 1
+"$FINDDUPS" --keep-cache -p 0 --lockstep=0 "$TREE" > /dev/null
+
+# Pulls a number out of the --stats=json report
+field() {
+    sed -n "s/.*\"$1\": \([0-9.]*\).*/\1/p" | head -1
+}
+
+echo "threads,mode,seconds,files,bytes_read,files/s,MB/s"
+for j in $THREADS; do
+    for mode in default no-partial no-lockstep mmap xxh64 verify spill; do
+        case $mode in
+        default)     flags="" ;;
+        no-partial)  flags="-p 0" ;;
+        no-lockstep) flags="--lockstep=0" ;;
+        mmap)        flags="--mmap" ;;
+        xxh64)       flags="--hash=xxh64" ;;
+        verify)      flags="--verify" ;;
+        spill)       flags="--spill-dir=$SPILL --mem-limit=64" ;;
+        esac
+        start=$(date +%s%N)
+        stats=$("$FINDDUPS" --keep-cache --stats=json $flags -j "$j" "$TREE" 2>&1 > /dev/null)
+        end=$(date +%s%N)
+        ns=$((end - start))
+        files=$(echo "$stats" | field files)
+        bytes=$(echo "$stats" | field bytes_read)
+        ms=$((ns > 1000000 ? ns / 1000000 : 1))
+        printf '%d,%s,%d.%03d,%d,%d,%d,%d\n' "$j" "$mode" $((ns / 1000000000)) $((ns / 1000000 % 1000)) \
+               "$files" "$bytes" $((files * 1000 / ms)) $((bytes / 1000 / ms))
+    done
+done
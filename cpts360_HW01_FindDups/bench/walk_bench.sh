@@ -0,0 +1,44 @@
+#!/bin/bash
+#
+#  walk_bench.sh
+#  PA01_FindDups
+#
+#  Times directory traversal on a synthetic tree of FANOUT^3 directories
+#  (the default of 100 gives 1,010,100 directories) at several thread
+#  counts. Each second-level directory holds one small file of a distinct
+#  size, so nothing is hashed and the run measures metadata work only.
+#  Each thread count is run once with the d_type fast path and once with
+#  --stat-all; the last columns are the walker's own syscall counts.
+#
+#  usage: bench/walk_bench.sh [tree-dir] [fanout] [thread counts...]
+#
+
+FINDDUPS=${FINDDUPS:-./finddups}
+TREE=${1:-/tmp/finddups_walk_tree}
+FANOUT=${2:-100}
+shift 2 2>/dev/null
+THREADS=${*:-"1 2 4 8 16 32"}
+
+if [ ! -d "$TREE" ]; then
+    echo "building $TREE ($FANOUT^3 directories)..." >&2
+    for ((i = 0; i < FANOUT; i++)); do
+        mkdir -p "$TREE/d$i" || exit 1
+        (cd "$TREE/d$i" && eval "mkdir -p d{0..$((FANOUT - 1))}/d{0..$((FANOUT - 1))}") || exit 1
+        printf '%*s' $((i + 1)) '' > "$TREE/d$i/f"
+    done
+fi
+
+echo "threads,mode,seconds,getdents64,stats"
+for j in $THREADS; do
+    for mode in d_type stat-all; do
+        flags=-v
+        [ "$mode" = stat-all ] && flags="-v --stat-all"
+        sync
+        start=$(date +%s%N)
+        counts=$("$FINDDUPS" $flags -j "$j" "$TREE" 2>&1 > /dev/null |
+                 sed -n 's/^directories read: *[0-9]* (\([0-9]*\) getdents64, \([0-9]*\) stat calls)/\1,\2/p')
+        end=$(date +%s%N)
+        ns=$((end - start))
+        printf '%d,%s,%d.%03d,%s\n' "$j" "$mode" $((ns / 1000000000)) $((ns / 1000000 % 1000)) "$counts"
+    done
+done
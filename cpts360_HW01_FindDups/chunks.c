@@ -0,0 +1,515 @@
+//
+//  chunks.c
+//  PA01_FindDups
+//
+//  FastCDC with normalized chunking: a gear hash rolls over each byte, and
+//  a cut is made where its masked bits are zero. Before the average size a
+//  stricter mask (more bits) is used and after it a looser one, which
+//  pulls chunk sizes toward the average. Cut points depend only on nearby
+//  content, so an insertion or an appended tail shifts at most a chunk or
+//  two and everything else still matches.
+//
+//  Workers chunk whole files and hand their chunks to the index in
+//  batches under one lock. The index keeps one record per distinct chunk
+//  plus an 8-byte (chunk, file) record per occurrence, and the report is
+//  computed from those once every file is done. A chunk referenced r
+//  times is charged size / r to each occurrence, so a directory's dedup
+//  ratio (logical bytes / charged bytes) does not depend on scan order.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h> // for PATH_MAX
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "chunks.h"
+#include "stats.h"
+
+#define CHUNK_MIN (2 * 1024)
+#define CHUNK_AVG (8 * 1024)
+#define CHUNK_MAX (64 * 1024)
+#define MASK_S 0x0003590703530000ULL // 15 bits, used below CHUNK_AVG
+#define MASK_L 0x0000d90003530000ULL // 11 bits, used above it
+#define CHUNK_READ_SIZE (1024 * 1024)
+#define CHUNK_BATCH 256              // Chunks a worker hands over per lock
+#define INDEX_INITIAL (1 << 16)
+#define PAIR_FILES_MAX 64            // Chunks in more files are left out of the pair list
+
+// One distinct chunk
+typedef struct {
+    unsigned char digest[DIGEST_LEN];
+    uint32_t size;
+    uint32_t refs;        // Occurrences, within and across files
+    uint32_t first_file;  // File it was first seen in, until multi_file is set
+    uint32_t multi_file;  // Seen in more than one file
+} Chunk;
+
+typedef struct {
+    uint32_t chunk, file;
+} Occurrence;
+
+typedef struct {
+    unsigned char digest[DIGEST_LEN];
+    uint32_t size;
+} PendingChunk;
+
+typedef struct {
+    const FileTable* table;
+    const uint32_t* files; // Entries to chunk: one name per inode
+    uint32_t nfiles;
+    atomic_uint next;
+
+    pthread_mutex_t lock;  // Guards everything below
+    uint32_t* slots;       // Open addressing over chunk ids + 1 (0 = empty)
+    size_t nslots;
+    Chunk* chunks;
+    size_t nchunks, chunks_cap;
+    Occurrence* occ;
+    size_t nocc, occ_cap;
+} ChunkIndex;
+
+typedef struct {
+    uint64_t key;   // file a << 32 | file b, a < b
+    uint64_t bytes;
+} Pair;
+
+static uint64_t gear[256];
+
+// splitmix64: fills the gear table the same way on every run
+static void init_gear(void) {
+    uint64_t x = 0x6a09e667f3bcc909ULL;
+    for (int i = 0; i < 256; i++) {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        gear[i] = z ^ (z >> 31);
+    }
+}
+
+static void* grow(void* p, size_t* cap, size_t elem) {
+    *cap = *cap ? *cap * 2 : 1024;
+    p = realloc(p, *cap * elem);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for chunk index\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static size_t slot_of(const ChunkIndex* idx, const unsigned char* digest) {
+    uint64_t h;
+    memcpy(&h, digest, sizeof(h));
+    return (h * 0x9E3779B97F4A7C15ULL) >> 20 & (idx->nslots - 1);
+}
+
+static void index_rehash(ChunkIndex* idx) {
+    free(idx->slots);
+    idx->nslots = idx->nslots ? idx->nslots * 2 : INDEX_INITIAL;
+    idx->slots = calloc(idx->nslots, sizeof(uint32_t));
+    if (!idx->slots) {
+        fprintf(stderr, "Memory allocation failed for chunk index\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t id = 0; id < idx->nchunks; id++) {
+        size_t s = slot_of(idx, idx->chunks[id].digest);
+        while (idx->slots[s]) s = (s + 1) & (idx->nslots - 1);
+        idx->slots[s] = (uint32_t)id + 1;
+    }
+}
+
+// Records one occurrence of a chunk in `file`; caller holds the lock
+static void index_add(ChunkIndex* idx, const PendingChunk* pc, uint32_t file) {
+    if (2 * (idx->nchunks + 1) > idx->nslots) index_rehash(idx);
+
+    size_t s = slot_of(idx, pc->digest);
+    uint32_t id;
+    for (;;) {
+        if (!idx->slots[s]) {
+            if (idx->nchunks == idx->chunks_cap) {
+                idx->chunks = grow(idx->chunks, &idx->chunks_cap, sizeof(Chunk));
+            }
+            id = (uint32_t)idx->nchunks++;
+            Chunk* c = &idx->chunks[id];
+            memcpy(c->digest, pc->digest, DIGEST_LEN);
+            c->size = pc->size;
+            c->refs = 0;
+            c->first_file = file;
+            c->multi_file = 0;
+            idx->slots[s] = id + 1;
+            break;
+        }
+        id = idx->slots[s] - 1;
+        if (memcmp(idx->chunks[id].digest, pc->digest, DIGEST_LEN) == 0) break;
+        s = (s + 1) & (idx->nslots - 1);
+    }
+
+    Chunk* c = &idx->chunks[id];
+    c->refs++;
+    if (c->first_file != file) c->multi_file = 1;
+    if (idx->nocc == idx->occ_cap) idx->occ = grow(idx->occ, &idx->occ_cap, sizeof(Occurrence));
+    idx->occ[idx->nocc++] = (Occurrence){ id, file };
+}
+
+static void flush_pending(ChunkIndex* idx, PendingChunk* pending, int* npending, uint32_t file) {
+    pthread_mutex_lock(&idx->lock);
+    for (int i = 0; i < *npending; i++) index_add(idx, &pending[i], file);
+    pthread_mutex_unlock(&idx->lock);
+    *npending = 0;
+}
+
+// Streams one file through the chunker; returns -1 if it cannot be read
+static int chunk_file(ChunkIndex* idx, uint32_t file, DigestCtx* ctx, unsigned char* buf,
+                      PendingChunk* pending) {
+    char path[PATH_MAX];
+    const FileEntry* entry = &idx->table->entries[file];
+    if (entry_path(entry, path, sizeof(path)) != 0) {
+        fprintf(stderr, "Path too long: %s\n", entry->name);
+        return -1;
+    }
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    count_open();
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    int npending = 0;
+    uint64_t h = 0;
+    uint32_t len = 0; // Bytes in the chunk being built
+    off_t offset = 0;
+    int status = 0;
+    digest_init(ctx);
+    for (;;) {
+        ssize_t n = pread(fd, buf, CHUNK_READ_SIZE, offset);
+        count_read(n);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Cannot read file %s: %s\n", path, strerror(errno));
+            status = -1;
+            break;
+        }
+        if (n == 0) break;
+        offset += n;
+
+        ssize_t start = 0; // Part of buf not yet fed to the digest
+        for (ssize_t i = 0; i < n; i++) {
+            len++;
+            if (len <= CHUNK_MIN) continue; // No cut can fall this early
+            h = (h << 1) + gear[buf[i]];
+            int cut = len < CHUNK_AVG ? !(h & MASK_S) : len < CHUNK_MAX ? !(h & MASK_L) : 1;
+            if (!cut) continue;
+
+            digest_update(ctx, buf + start, i + 1 - start);
+            digest_final(ctx, pending[npending].digest);
+            pending[npending++].size = len;
+            if (npending == CHUNK_BATCH) flush_pending(idx, pending, &npending, file);
+            digest_init(ctx);
+            start = i + 1;
+            h = 0;
+            len = 0;
+        }
+        digest_update(ctx, buf + start, n - start);
+    }
+    if (status == 0 && len > 0) { // Tail chunk
+        digest_final(ctx, pending[npending].digest);
+        pending[npending++].size = len;
+    }
+    if (npending > 0) flush_pending(idx, pending, &npending, file);
+
+    if (!read_mode.keep_cache) posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    return status;
+}
+
+static void* chunk_worker(void* arg) {
+    ChunkIndex* idx = arg;
+    DigestCtx* ctx = digest_new(digest_algo);
+    unsigned char* buf = malloc(CHUNK_READ_SIZE);
+    PendingChunk* pending = malloc(sizeof(PendingChunk) * CHUNK_BATCH);
+    if (!buf || !pending) {
+        fprintf(stderr, "Memory allocation failed for chunking\n");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned int i;
+    while ((i = atomic_fetch_add(&idx->next, 1)) < idx->nfiles) {
+        if (chunk_file(idx, idx->files[i], ctx, buf, pending) != 0) {
+            __atomic_fetch_add(&stage_counts.unreadable, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    digest_free(ctx);
+    free(buf);
+    free(pending);
+    return NULL;
+}
+
+static const FileTable* sort_table; // qsort() takes no context argument
+
+// Sort function for qsort (orders entry indices by inode)
+static int compare_inode_ids(const void* a, const void* b) {
+    const FileEntry* fileA = &sort_table->entries[*(const uint32_t*)a];
+    const FileEntry* fileB = &sort_table->entries[*(const uint32_t*)b];
+    if (fileA->dev != fileB->dev) return (fileA->dev > fileB->dev) ? 1 : -1;
+    return (fileA->ino > fileB->ino) - (fileA->ino < fileB->ino);
+}
+
+// Same, with the names of one inode in path order; the first is chunked
+static int compare_inode_names(const void* a, const void* b) {
+    int c = compare_inode_ids(a, b);
+    if (c) return c;
+    char pathA[PATH_MAX], pathB[PATH_MAX];
+    entry_path(&sort_table->entries[*(const uint32_t*)a], pathA, sizeof(pathA));
+    entry_path(&sort_table->entries[*(const uint32_t*)b], pathB, sizeof(pathB));
+    return strcmp(pathA, pathB);
+}
+
+// Sort function for qsort (orders entry indices by directory path)
+static int compare_dir_ids(const void* a, const void* b) {
+    const DirNode* dirA = sort_table->entries[*(const uint32_t*)a].dir;
+    const DirNode* dirB = sort_table->entries[*(const uint32_t*)b].dir;
+    if (dirA == dirB) return 0;
+    char pathA[PATH_MAX] = "", pathB[PATH_MAX] = "";
+    if (dirA) dirnode_path(dirA, pathA, sizeof(pathA));
+    if (dirB) dirnode_path(dirB, pathB, sizeof(pathB));
+    int c = strcmp(pathA, pathB);
+    return c ? c : (dirA > dirB) - (dirA < dirB);
+}
+
+// Sort function for qsort (orders occurrences by chunk, then file)
+static int compare_occurrences(const void* a, const void* b) {
+    const Occurrence* occA = a;
+    const Occurrence* occB = b;
+    if (occA->chunk != occB->chunk) return occA->chunk > occB->chunk ? 1 : -1;
+    return (occA->file > occB->file) - (occA->file < occB->file);
+}
+
+// Paths of the two files in a pair, in path order
+static void pair_paths(const Pair* pair, char* first, char* second) {
+    entry_path(&sort_table->entries[pair->key >> 32], first, PATH_MAX);
+    entry_path(&sort_table->entries[(uint32_t)pair->key], second, PATH_MAX);
+    if (strcmp(first, second) > 0) {
+        char tmp[PATH_MAX];
+        strcpy(tmp, first);
+        strcpy(first, second);
+        strcpy(second, tmp);
+    }
+}
+
+// Sort function for qsort (orders pairs by shared bytes, most first, then
+// by path so the order does not depend on the scan)
+static int compare_pairs(const void* a, const void* b) {
+    const Pair* pairA = a;
+    const Pair* pairB = b;
+    if (pairA->bytes != pairB->bytes) return pairA->bytes < pairB->bytes ? 1 : -1;
+    char firstA[PATH_MAX], secondA[PATH_MAX], firstB[PATH_MAX], secondB[PATH_MAX];
+    pair_paths(pairA, firstA, secondA);
+    pair_paths(pairB, firstB, secondB);
+    int c = strcmp(firstA, firstB);
+    return c ? c : strcmp(secondA, secondB);
+}
+
+// Adds `bytes` to the pair (a, b) in an open-addressing map
+static void pair_add(Pair** map, size_t* nslots, size_t* count, uint32_t a, uint32_t b, uint64_t bytes) {
+    if (2 * (*count + 1) > *nslots) {
+        size_t old = *nslots;
+        Pair* old_map = *map;
+        *nslots = old ? old * 2 : 1024;
+        *map = calloc(*nslots, sizeof(Pair));
+        if (!*map) {
+            fprintf(stderr, "Memory allocation failed for chunk pairs\n");
+            exit(EXIT_FAILURE);
+        }
+        *count = 0;
+        for (size_t i = 0; i < old; i++) {
+            if (old_map[i].bytes) {
+                pair_add(map, nslots, count, old_map[i].key >> 32, (uint32_t)old_map[i].key,
+                         old_map[i].bytes);
+            }
+        }
+        free(old_map);
+    }
+    uint64_t key = a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+    size_t s = (key * 0x9E3779B97F4A7C15ULL) >> 20 & (*nslots - 1);
+    while ((*map)[s].bytes && (*map)[s].key != key) s = (s + 1) & (*nslots - 1);
+    if (!(*map)[s].bytes) (*count)++;
+    (*map)[s].key = key;
+    (*map)[s].bytes += bytes;
+}
+
+static void print_report(ChunkIndex* idx, int top_pairs) {
+    const FileTable* table = idx->table;
+    size_t nentries = table->count;
+    uint64_t* shared = calloc(nentries, sizeof(uint64_t)); // Bytes also found in another file
+    double* charged = calloc(nentries, sizeof(double));    // Share of the stored bytes
+    if (!shared || !charged) {
+        fprintf(stderr, "Memory allocation failed for chunk report\n");
+        exit(EXIT_FAILURE);
+    }
+
+    Pair* pairs = NULL;
+    size_t pair_slots = 0, npairs = 0;
+    uint64_t logical = 0, stored = 0;
+    for (size_t i = 0; i < idx->nocc; i++) {
+        const Occurrence* o = &idx->occ[i];
+        const Chunk* c = &idx->chunks[o->chunk];
+        logical += c->size;
+        charged[o->file] += (double)c->size / c->refs;
+        if (c->multi_file) shared[o->file] += c->size;
+    }
+    for (size_t i = 0; i < idx->nchunks; i++) stored += idx->chunks[i].size;
+
+    // Every pair of files holding a chunk shares it as many times as the
+    // file with fewer copies holds it. Chunks found in very many files
+    // (runs of zeros, common headers) would add a quadratic number of
+    // pairs that say little, so they only count toward the totals.
+    qsort(idx->occ, idx->nocc, sizeof(Occurrence), compare_occurrences);
+    uint32_t holders[PAIR_FILES_MAX], copies[PAIR_FILES_MAX];
+    for (size_t start = 0, end; start < idx->nocc; start = end) {
+        uint32_t id = idx->occ[start].chunk;
+        for (end = start; end < idx->nocc && idx->occ[end].chunk == id; end++) {}
+        if (!idx->chunks[id].multi_file) continue;
+
+        int nholders = 0;
+        for (size_t i = start; i < end && nholders <= PAIR_FILES_MAX; i++) {
+            if (nholders > 0 && holders[nholders - 1] == idx->occ[i].file) {
+                copies[nholders - 1]++;
+            } else if (nholders < PAIR_FILES_MAX) {
+                holders[nholders] = idx->occ[i].file;
+                copies[nholders++] = 1;
+            } else {
+                nholders++; // Too many files
+            }
+        }
+        if (nholders > PAIR_FILES_MAX) continue;
+        for (int a = 0; a < nholders; a++) {
+            for (int b = a + 1; b < nholders; b++) {
+                uint32_t times = copies[a] < copies[b] ? copies[a] : copies[b];
+                pair_add(&pairs, &pair_slots, &npairs, holders[a], holders[b],
+                         (uint64_t)times * idx->chunks[id].size);
+            }
+        }
+    }
+
+    // Pairs sharing the most bytes first
+    size_t n = 0;
+    for (size_t i = 0; i < pair_slots; i++) {
+        if (pairs[i].bytes) pairs[n++] = pairs[i];
+    }
+    sort_table = table;
+    qsort(pairs, n, sizeof(Pair), compare_pairs);
+    char pathA[PATH_MAX], pathB[PATH_MAX];
+    printf("# shared-bytes %%-of-smaller file-a file-b\n");
+    for (size_t i = 0; i < n && i < (size_t)top_pairs; i++) {
+        const FileEntry* a = &table->entries[pairs[i].key >> 32];
+        const FileEntry* b = &table->entries[(uint32_t)pairs[i].key];
+        uint64_t smaller = a->size < b->size ? a->size : b->size;
+        pair_paths(&pairs[i], pathA, pathB);
+        printf("%llu %.1f%% %s %s\n", (unsigned long long)pairs[i].bytes,
+               smaller ? 100.0 * (pairs[i].bytes > smaller ? smaller : pairs[i].bytes) / smaller : 0.0,
+               pathA, pathB);
+    }
+    free(pairs);
+
+    // Directories, in path order
+    uint32_t* by_dir = malloc(sizeof(uint32_t) * (idx->nfiles + 1));
+    if (!by_dir) {
+        fprintf(stderr, "Memory allocation failed for chunk report\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(by_dir, idx->files, sizeof(uint32_t) * idx->nfiles);
+    sort_table = table;
+    qsort(by_dir, idx->nfiles, sizeof(uint32_t), compare_dir_ids);
+    printf("# files logical-bytes shared-bytes dedup-ratio directory\n");
+    for (uint32_t start = 0; start < idx->nfiles;) {
+        const DirNode* dir = table->entries[by_dir[start]].dir;
+        uint64_t dir_logical = 0, dir_shared = 0;
+        double dir_charged = 0;
+        uint32_t end = start;
+        for (; end < idx->nfiles && table->entries[by_dir[end]].dir == dir; end++) {
+            dir_logical += table->entries[by_dir[end]].size;
+            dir_shared += shared[by_dir[end]];
+            dir_charged += charged[by_dir[end]];
+        }
+        if (!dir || dirnode_path(dir, pathA, sizeof(pathA)) != 0) strcpy(pathA, "(command line)");
+        printf("%u %llu %llu %.2f %s\n", end - start, (unsigned long long)dir_logical,
+               (unsigned long long)dir_shared, dir_charged > 0 ? dir_logical / dir_charged : 1.0, pathA);
+        start = end;
+    }
+    printf("# total: %u files, %llu bytes, %zu chunks (%zu distinct), %llu bytes stored, dedup ratio %.2f\n",
+           idx->nfiles, (unsigned long long)logical, idx->nocc, idx->nchunks,
+           (unsigned long long)stored, stored ? (double)logical / stored : 1.0);
+
+    free(by_dir);
+    free(shared);
+    free(charged);
+}
+
+void chunk_report(const FileTable* table, int top_pairs, int nthreads) {
+    init_gear();
+    stage_counts.files = table->count;
+
+    // One name per inode: hardlinks share every byte by definition
+    uint32_t* files = malloc(sizeof(uint32_t) * (table->count + 1));
+    if (!files) {
+        fprintf(stderr, "Memory allocation failed for chunking\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < table->count; i++) files[i] = (uint32_t)i;
+    sort_table = table;
+    qsort(files, table->count, sizeof(uint32_t), compare_inode_names);
+    uint32_t nfiles = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        if (nfiles > 0 && compare_inode_ids(&files[nfiles - 1], &files[i]) == 0) {
+            stage_counts.links++;
+            continue;
+        }
+        files[nfiles++] = files[i];
+    }
+
+    ChunkIndex idx;
+    memset(&idx, 0, sizeof(idx));
+    idx.table = table;
+    idx.files = files;
+    idx.nfiles = nfiles;
+    atomic_init(&idx.next, 0);
+    pthread_mutex_init(&idx.lock, NULL);
+    index_rehash(&idx);
+
+    phase_begin(PHASE_HASH);
+    int n = nthreads < (int)nfiles ? nthreads : (int)nfiles;
+    if (n <= 1) {
+        chunk_worker(&idx);
+    } else {
+        pthread_t* tids = malloc(sizeof(pthread_t) * n);
+        if (!tids) {
+            fprintf(stderr, "Memory allocation failed for chunking threads\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < n; i++) {
+            if (pthread_create(&tids[i], NULL, chunk_worker, &idx) != 0) {
+                fprintf(stderr, "Cannot start chunking thread\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (int i = 0; i < n; i++) pthread_join(tids[i], NULL);
+        free(tids);
+    }
+    phase_end(PHASE_HASH);
+
+    phase_begin(PHASE_GROUP);
+    print_report(&idx, top_pairs);
+    phase_end(PHASE_GROUP);
+
+    pthread_mutex_destroy(&idx.lock);
+    free(idx.slots);
+    free(idx.chunks);
+    free(idx.occ);
+    free(files);
+}
@@ -0,0 +1,20 @@
+//
+//  chunks.h
+//  PA01_FindDups
+//
+//  Content-defined chunking mode (--chunks): finds data shared between
+//  files that are not identical as a whole.
+//
+#ifndef CHUNKS_H
+#define CHUNKS_H
+
+#include "finddups.h"
+
+// Splits every file in `table` into FastCDC chunks (2 / 8 / 64 KiB min /
+// average / max), indexes the chunk digests and prints the `top_pairs`
+// file pairs sharing the most bytes, each directory's shared bytes and
+// dedup ratio, and the totals. Files are chunked on `nthreads` threads;
+// each one streams through a single read buffer.
+void chunk_report(const FileTable* table, int top_pairs, int nthreads);
+
+#endif // CHUNKS_H
@@ -0,0 +1,357 @@
+//
+//  digest.c
+//  PA01_FindDups
+//
+//  Digest backends. SHA-256 and BLAKE2b go through the OpenSSL EVP API;
+//  BLAKE2b is the faster of the two on CPUs without SHA extensions.
+//  xxh64 is XXH64 implemented here: non-cryptographic and several times
+//  faster than either, meant to be paired with --verify so that a 64-bit
+//  collision can never produce a false duplicate.
+//
+//  Files are read with pread() into a 1 MiB page-aligned buffer (LAB03's
+//  results.txt shows small buffers leave throughput on the table), or
+//  through mmap() with --mmap. The kernel is told the access pattern up
+//  front and asked to drop the pages afterwards.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <openssl/evp.h> // Replaces deprecated SHA256 functions
+
+#include "digest.h"
+#include "stats.h"
+
+#define READ_BUFFER_SIZE (1024 * 1024)
+#define READ_ALIGN 4096
+
+// XXH64 streaming state
+typedef struct {
+    uint64_t total_len;
+    uint64_t v[4];
+    unsigned char mem[32]; // Bytes not yet forming a full 32-byte stripe
+    size_t memsize;
+} Xxh64State;
+
+struct DigestAlgo {
+    const char* name;
+    const EVP_MD* (*evp)(void); // NULL for the built-in XXH64
+};
+
+struct DigestCtx {
+    const DigestAlgo* algo;
+    EVP_MD_CTX* mdctx;
+    Xxh64State xxh;
+    unsigned char* buf; // READ_BUFFER_SIZE bytes, READ_ALIGN-aligned
+};
+
+static const DigestAlgo algos[] = {
+    { "sha256",  EVP_sha256 },
+    { "blake2b", EVP_blake2b512 },
+    { "xxh64",   NULL },
+};
+
+#define N_ALGOS (sizeof(algos) / sizeof(algos[0]))
+
+const DigestAlgo* digest_lookup(const char* name) {
+    for (size_t i = 0; i < N_ALGOS; i++) {
+        if (strcmp(algos[i].name, name) == 0) return &algos[i];
+    }
+    return NULL;
+}
+
+const char* digest_name(const DigestAlgo* algo) {
+    return algo->name;
+}
+
+const char* digest_names(void) {
+    return "sha256, blake2b, xxh64";
+}
+
+// ---- XXH64 ----
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v)); // Little-endian hosts only, like the rest of the tool
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+static void xxh64_init(Xxh64State* st) {
+    memset(st, 0, sizeof(*st));
+    st->v[0] = PRIME64_1 + PRIME64_2;
+    st->v[1] = PRIME64_2;
+    st->v[2] = 0;
+    st->v[3] = -PRIME64_1;
+}
+
+static void xxh64_stripe(Xxh64State* st, const unsigned char* p) {
+    st->v[0] = xxh64_round(st->v[0], read64(p));
+    st->v[1] = xxh64_round(st->v[1], read64(p + 8));
+    st->v[2] = xxh64_round(st->v[2], read64(p + 16));
+    st->v[3] = xxh64_round(st->v[3], read64(p + 24));
+}
+
+static void xxh64_update(Xxh64State* st, const unsigned char* p, size_t len) {
+    st->total_len += len;
+
+    if (st->memsize + len < 32) {
+        memcpy(st->mem + st->memsize, p, len);
+        st->memsize += len;
+        return;
+    }
+    if (st->memsize) {
+        size_t fill = 32 - st->memsize;
+        memcpy(st->mem + st->memsize, p, fill);
+        xxh64_stripe(st, st->mem);
+        p += fill;
+        len -= fill;
+        st->memsize = 0;
+    }
+    while (len >= 32) {
+        xxh64_stripe(st, p);
+        p += 32;
+        len -= 32;
+    }
+    memcpy(st->mem, p, len);
+    st->memsize = len;
+}
+
+static uint64_t xxh64_digest(const Xxh64State* st) {
+    uint64_t h;
+    if (st->total_len >= 32) {
+        h = rotl64(st->v[0], 1) + rotl64(st->v[1], 7) + rotl64(st->v[2], 12) + rotl64(st->v[3], 18);
+        for (int i = 0; i < 4; i++) h = xxh64_merge(h, st->v[i]);
+    } else {
+        h = st->v[2] + PRIME64_5;
+    }
+    h += st->total_len;
+
+    const unsigned char* p = st->mem;
+    size_t len = st->memsize;
+    while (len >= 8) {
+        h ^= xxh64_round(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+        len -= 8;
+    }
+    if (len >= 4) {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        p++;
+        len--;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+// ---- generic interface ----
+
+DigestCtx* digest_new(const DigestAlgo* algo) {
+    DigestCtx* ctx = calloc(1, sizeof(DigestCtx));
+    if (!ctx) {
+        fprintf(stderr, "Memory allocation failed for digest context\n");
+        exit(EXIT_FAILURE);
+    }
+    ctx->algo = algo;
+    if (algo->evp && !(ctx->mdctx = EVP_MD_CTX_new())) {
+        fprintf(stderr, "Failed to create EVP_MD_CTX\n");
+        exit(EXIT_FAILURE);
+    }
+    return ctx;
+}
+
+void digest_init(DigestCtx* ctx) {
+    if (ctx->algo->evp) {
+        EVP_DigestInit_ex(ctx->mdctx, ctx->algo->evp(), NULL);
+    } else {
+        xxh64_init(&ctx->xxh);
+    }
+}
+
+void digest_update(DigestCtx* ctx, const void* data, size_t len) {
+    if (ctx->algo->evp) {
+        EVP_DigestUpdate(ctx->mdctx, data, len);
+    } else {
+        xxh64_update(&ctx->xxh, data, len);
+    }
+}
+
+void digest_final(DigestCtx* ctx, unsigned char* digest) {
+    memset(digest, 0, DIGEST_LEN);
+    if (ctx->algo->evp) {
+        unsigned char hash[EVP_MAX_MD_SIZE]; // Buffer to store hash output
+        unsigned int hash_len;
+
+        EVP_DigestFinal_ex(ctx->mdctx, hash, &hash_len);
+        memcpy(digest, hash, hash_len < DIGEST_LEN ? hash_len : DIGEST_LEN);
+    } else {
+        uint64_t h = xxh64_digest(&ctx->xxh);
+        for (int i = 0; i < 8; i++) {
+            digest[i] = (unsigned char)(h >> (56 - 8 * i)); // Canonical big-endian form
+        }
+    }
+}
+
+void digest_free(DigestCtx* ctx) {
+    EVP_MD_CTX_free(ctx->mdctx);
+    free(ctx->buf);
+    free(ctx);
+}
+
+// ---- file hashing ----
+
+ReadMode read_mode = { 0, 0 };
+
+// Returns the context's aligned read buffer, allocating it on first use
+static unsigned char* read_buffer(DigestCtx* ctx) {
+    if (!ctx->buf && posix_memalign((void**)&ctx->buf, READ_ALIGN, READ_BUFFER_SIZE) != 0) {
+        fprintf(stderr, "Memory allocation failed for read buffer\n");
+        exit(EXIT_FAILURE);
+    }
+    return ctx->buf;
+}
+
+// Feeds `len` bytes starting at `offset` into the digest (len 0 = to EOF)
+static int digest_range(DigestCtx* ctx, int fd, off_t offset, size_t len) {
+    unsigned char* buf = read_buffer(ctx);
+    for (;;) {
+        size_t want = READ_BUFFER_SIZE;
+        if (len > 0 && len < want) want = len;
+        ssize_t n = pread(fd, buf, want, offset);
+        count_read(n);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        digest_update(ctx, buf, n);
+        offset += n;
+        if (len > 0 && (len -= n) == 0) break;
+    }
+    return 0;
+}
+
+// Hashes the whole file through a read-only mapping
+static int digest_mapped(DigestCtx* ctx, int fd) {
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) return -1;
+    if (sb.st_size == 0) return 0; // Nothing to map
+
+    void* map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return -1;
+    madvise(map, sb.st_size, MADV_SEQUENTIAL);
+    count_read(sb.st_size);
+    digest_update(ctx, map, sb.st_size);
+    munmap(map, sb.st_size);
+    return 0;
+}
+
+static int open_for_hashing(const char* filename, int advice) {
+    int fd = open(filename, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open file %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+    count_open();
+    posix_fadvise(fd, 0, 0, advice);
+    return fd;
+}
+
+// Drops the pages we pulled in, unless asked to keep them, so a scan of
+// the whole disk does not push everything else out of the page cache.
+static void close_after_hashing(int fd) {
+    if (!read_mode.keep_cache) posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+static int hash_whole(DigestCtx* ctx, const char* filename, unsigned char* digest) {
+    int fd = open_for_hashing(filename, POSIX_FADV_SEQUENTIAL);
+    if (fd < 0) return -1;
+
+    digest_init(ctx);
+    int status = read_mode.use_mmap ? digest_mapped(ctx, fd) : digest_range(ctx, fd, 0, 0);
+    if (status != 0) {
+        fprintf(stderr, "Cannot read file %s: %s\n", filename, strerror(errno));
+        close_after_hashing(fd);
+        return -1;
+    }
+    digest_final(ctx, digest);
+    close_after_hashing(fd);
+    return 0;
+}
+
+static int hash_ends(DigestCtx* ctx, const char* filename, size_t size, size_t block,
+                     unsigned char* digest) {
+    // Random: readahead past the head block would be wasted I/O
+    int fd = open_for_hashing(filename, POSIX_FADV_RANDOM);
+    if (fd < 0) return -1;
+
+    digest_init(ctx);
+    if (digest_range(ctx, fd, 0, block) != 0 ||
+        digest_range(ctx, fd, (off_t)(size - block), block) != 0) {
+        fprintf(stderr, "Cannot read file %s: %s\n", filename, strerror(errno));
+        close_after_hashing(fd);
+        return -1;
+    }
+    digest_final(ctx, digest);
+    close_after_hashing(fd);
+    return 0;
+}
+
+int hash_file(DigestCtx* ctx, const char* filename, unsigned char* digest) {
+    long long start = now_ns();
+    int status = hash_whole(ctx, filename, digest);
+    atomic_fetch_add_explicit(&run_counters.hash_ns, now_ns() - start, memory_order_relaxed);
+    return status;
+}
+
+int partial_hash_file(DigestCtx* ctx, const char* filename, size_t size, size_t block,
+                      unsigned char* digest) {
+    long long start = now_ns();
+    int status = hash_ends(ctx, filename, size, block, digest);
+    atomic_fetch_add_explicit(&run_counters.hash_ns, now_ns() - start, memory_order_relaxed);
+    return status;
+}
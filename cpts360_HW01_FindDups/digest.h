@@ -0,0 +1,45 @@
+//
+//  digest.h
+//  PA01_FindDups
+//
+//  Pluggable digest backends and the routines that hash files with them.
+//
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <stddef.h>
+
+#include "filestore.h"
+
+typedef struct DigestAlgo DigestAlgo;
+typedef struct DigestCtx DigestCtx;
+
+// Looks up a backend by name ("sha256", "blake2b", "xxh64"); NULL if unknown
+const DigestAlgo* digest_lookup(const char* name);
+const char* digest_name(const DigestAlgo* algo);
+// Comma-separated list of backend names, for usage messages
+const char* digest_names(void);
+
+// A context is reused across files, so each hashing thread owns one
+DigestCtx* digest_new(const DigestAlgo* algo);
+void digest_init(DigestCtx* ctx);
+void digest_update(DigestCtx* ctx, const void* data, size_t len);
+// Writes DIGEST_LEN bytes; shorter digests are zero-padded
+void digest_final(DigestCtx* ctx, unsigned char* digest);
+void digest_free(DigestCtx* ctx);
+
+// How hash_file() reads; set once before hashing starts
+typedef struct {
+    int use_mmap;   // Map the file instead of reading it into a buffer
+    int keep_cache; // Skip POSIX_FADV_DONTNEED after hashing
+} ReadMode;
+
+extern ReadMode read_mode;
+
+// Hashes a whole file, or only its first and last `block` bytes (callers
+// only do this when size > 2 * block, so the blocks never overlap).
+int hash_file(DigestCtx* ctx, const char* filename, unsigned char* digest);
+int partial_hash_file(DigestCtx* ctx, const char* filename, size_t size, size_t block,
+                      unsigned char* digest);
+
+#endif // DIGEST_H
@@ -0,0 +1,191 @@
+//
+//  digestcache.c
+//  PA01_FindDups
+//
+//  On-disk layout: a CacheHeader followed by `count` CacheRecords sorted
+//  by (dev, ino), so a lookup is a binary search in the mapped file and
+//  startup costs one mmap() regardless of cache size.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h> // for PATH_MAX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "digestcache.h"
+
+#define CACHE_MAGIC "FDCACHE1"
+#define DIGEST_NAME_LEN 16
+
+typedef struct {
+    char magic[8];
+    char digest_name[DIGEST_NAME_LEN]; // Digests from another algorithm never match
+    uint64_t count;
+} CacheHeader;
+
+typedef struct {
+    uint64_t dev, ino, size;
+    int64_t mtime_ns;
+    unsigned char digest[DIGEST_LEN];
+} CacheRecord;
+
+struct DigestCache {
+    void* map;
+    size_t map_len;
+    const CacheRecord* records;
+    uint64_t count;
+};
+
+DigestCache* cache_open(const char* path, const char* digest_name) {
+    DigestCache* cache = calloc(1, sizeof(DigestCache));
+    if (!cache) {
+        fprintf(stderr, "Memory allocation failed for digest cache\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            fprintf(stderr, "Cannot open cache %s: %s\n", path, strerror(errno));
+        }
+        return cache; // First run: start empty
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(CacheHeader)) {
+        fprintf(stderr, "Ignoring unreadable cache %s\n", path);
+        close(fd);
+        return cache;
+    }
+    void* map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Cannot map cache %s: %s\n", path, strerror(errno));
+        return cache;
+    }
+
+    // Bound the count by the file size before multiplying, so a corrupt
+    // count cannot wrap around to a size that matches
+    const CacheHeader* header = map;
+    size_t max_count = ((size_t)sb.st_size - sizeof(CacheHeader)) / sizeof(CacheRecord);
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->count > max_count ||
+        (size_t)sb.st_size != sizeof(CacheHeader) + header->count * sizeof(CacheRecord)) {
+        fprintf(stderr, "Ignoring corrupt cache %s\n", path);
+        munmap(map, sb.st_size);
+        return cache;
+    }
+    if (strncmp(header->digest_name, digest_name, DIGEST_NAME_LEN) != 0) {
+        munmap(map, sb.st_size); // Written with another digest: start over
+        return cache;
+    }
+
+    madvise(map, sb.st_size, MADV_RANDOM); // Binary search touches few pages
+    cache->map = map;
+    cache->map_len = sb.st_size;
+    cache->records = (const CacheRecord*)(header + 1);
+    cache->count = header->count;
+    return cache;
+}
+
+// Orders records (and entries) by file identity
+static int compare_identity(uint64_t devA, uint64_t inoA, uint64_t devB, uint64_t inoB) {
+    if (devA != devB) return devA < devB ? -1 : 1;
+    if (inoA != inoB) return inoA < inoB ? -1 : 1;
+    return 0;
+}
+
+int cache_lookup(const DigestCache* cache, FileEntry* entry) {
+    uint64_t lo = 0, hi = cache->count;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        const CacheRecord* rec = &cache->records[mid];
+        int cmp = compare_identity(entry->dev, entry->ino, rec->dev, rec->ino);
+        if (cmp == 0) {
+            // Same inode, but it only counts if the content cannot have changed
+            if (rec->size != entry->size || rec->mtime_ns != entry_mtime(entry)) return 0;
+            memcpy(entry->hash, rec->digest, DIGEST_LEN);
+            return 1;
+        }
+        if (cmp < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return 0;
+}
+
+static int compare_records(const void* a, const void* b) {
+    const CacheRecord* recA = a;
+    const CacheRecord* recB = b;
+    return compare_identity(recA->dev, recA->ino, recB->dev, recB->ino);
+}
+
+int cache_save(const char* path, const char* digest_name, const FileTable* table) {
+    size_t count = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        if (table->entries[i].hashed) count++;
+    }
+
+    CacheRecord* records = malloc(sizeof(CacheRecord) * (count + 1));
+    if (!records) {
+        fprintf(stderr, "Memory allocation failed for digest cache\n");
+        return -1;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        const FileEntry* entry = &table->entries[i];
+        if (!entry->hashed) continue;
+        records[n].dev = entry->dev;
+        records[n].ino = entry->ino;
+        records[n].size = entry->size;
+        records[n].mtime_ns = entry_mtime(entry);
+        memcpy(records[n].digest, entry->hash, DIGEST_LEN);
+        n++;
+    }
+    qsort(records, n, sizeof(CacheRecord), compare_records);
+
+    // A file reached twice (e.g. named twice) must appear only once
+    size_t unique = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (unique == 0 || compare_records(&records[unique - 1], &records[i]) != 0) {
+            records[unique++] = records[i];
+        }
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    size_t name_len = strlen(digest_name);
+    memcpy(header.digest_name, digest_name, name_len < DIGEST_NAME_LEN ? name_len : DIGEST_NAME_LEN);
+    header.count = unique;
+
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%ld", path, (long)getpid());
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot create cache %s: %s\n", tmp_path, strerror(errno));
+        free(records);
+        return -1;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(records, sizeof(CacheRecord), unique, file) == unique &&
+             fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+    free(records);
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Cannot write cache %s: %s\n", path, strerror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+void cache_close(DigestCache* cache) {
+    if (cache->map) munmap(cache->map, cache->map_len);
+    free(cache);
+}
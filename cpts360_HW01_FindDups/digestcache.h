@@ -0,0 +1,31 @@
+//
+//  digestcache.h
+//  PA01_FindDups
+//
+//  Persistent digest cache for incremental rescans. A file whose
+//  (st_dev, st_ino, st_size, st_mtim) matches a cached record reuses the
+//  cached digest instead of being read again.
+//
+#ifndef DIGESTCACHE_H
+#define DIGESTCACHE_H
+
+#include "filestore.h"
+
+typedef struct DigestCache DigestCache;
+
+// Maps the cache file read-only. A missing file, or one written for a
+// different digest, gives an empty cache; the file is never modified.
+DigestCache* cache_open(const char* path, const char* digest_name);
+
+// Copies the cached digest into entry->hash and returns 1 if the entry's
+// identity and metadata match a record, otherwise returns 0.
+int cache_lookup(const DigestCache* cache, FileEntry* entry);
+
+// Replaces the cache file with a record for every entry that has a full
+// digest. The new file is written beside the old one and renamed over it,
+// so readers see either the old cache or the new one, never a mix.
+int cache_save(const char* path, const char* digest_name, const FileTable* table);
+
+void cache_close(DigestCache* cache);
+
+#endif // DIGESTCACHE_H
@@ -0,0 +1,208 @@
+//
+//  filestore.c
+//  PA01_FindDups
+//
+//  Arena, directory-node and file-table helpers. Paths are rebuilt on
+//  demand (to open or print a file), which costs far less than keeping a
+//  PATH_MAX buffer per file.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysmacros.h>
+
+#include "filestore.h"
+
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+#define TABLE_INITIAL 1024
+
+int store_mtimes = 0;
+
+struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used, size;
+    char data[];
+};
+
+// A file name stored with its scan-time mtime
+typedef struct {
+    int64_t mtime_ns;
+    char name[];
+} TimedName;
+
+uint32_t pack_dev(dev_t dev) {
+    return (uint32_t)(major(dev) << 20 | minor(dev));
+}
+
+dev_t unpack_dev(uint32_t dev) {
+    return makedev(dev >> 20, dev & 0xfffff);
+}
+
+void arena_init(Arena* arena) {
+    arena->head = NULL;
+}
+
+// Carves `size` bytes starting at a multiple of `align` (a power of two)
+static void* arena_bump(Arena* arena, size_t size, size_t align) {
+    ArenaBlock* block = arena->head;
+    size_t at = block ? (block->used + align - 1) & ~(align - 1) : 0;
+    if (!block || at > block->size || block->size - at < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(ArenaBlock) + block_size);
+        if (!block) {
+            fprintf(stderr, "Memory allocation failed for name arena\n");
+            exit(EXIT_FAILURE);
+        }
+        block->used = 0;
+        block->size = block_size;
+        block->next = arena->head;
+        arena->head = block;
+        at = 0;
+    }
+
+    block->used = at + size;
+    return block->data + at;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    return arena_bump(arena, size, 8); // Keep DirNode pointers aligned
+}
+
+const char* arena_strdup(Arena* arena, const char* s) {
+    size_t len = strlen(s) + 1;
+    char* copy = arena_bump(arena, len, 1); // Names need no alignment
+    memcpy(copy, s, len);
+    return copy;
+}
+
+const char* arena_filename(Arena* arena, const char* name, int64_t mtime_ns) {
+    if (!store_mtimes) return arena_strdup(arena, name);
+
+    size_t len = strlen(name) + 1;
+    TimedName* timed = arena_alloc(arena, sizeof(TimedName) + len);
+    timed->mtime_ns = mtime_ns;
+    memcpy(timed->name, name, len);
+    return timed->name;
+}
+
+const DirNode* arena_dirnode(Arena* arena, const DirNode* parent, const char* name) {
+    size_t len = strlen(name) + 1;
+    DirNode* node = arena_alloc(arena, sizeof(DirNode) + len);
+    node->parent = parent;
+    memcpy(node->name, name, len);
+    return node;
+}
+
+void arena_adopt(Arena* dst, Arena* src) {
+    if (!src->head) return;
+
+    // Keep filling dst's current block: put src's blocks behind it
+    ArenaBlock* tail = src->head;
+    while (tail->next) tail = tail->next;
+    if (dst->head) {
+        tail->next = dst->head->next;
+        dst->head->next = src->head;
+    } else {
+        dst->head = src->head;
+    }
+    src->head = NULL;
+}
+
+void arena_free(Arena* arena) {
+    while (arena->head) {
+        ArenaBlock* next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+}
+
+static void table_reserve(FileTable* table, size_t count) {
+    if (count <= table->capacity) return;
+
+    size_t capacity = table->capacity ? table->capacity : TABLE_INITIAL;
+    while (capacity < count) capacity *= 2;
+    FileEntry* entries = realloc(table->entries, sizeof(FileEntry) * capacity);
+    if (!entries) {
+        fprintf(stderr, "Memory allocation failed for file table\n");
+        exit(EXIT_FAILURE);
+    }
+    table->entries = entries;
+    table->capacity = capacity;
+}
+
+void table_add(FileTable* table, const DirNode* dir, const char* name, const struct stat* sb) {
+    table_reserve(table, table->count + 1);
+
+    FileEntry* entry = &table->entries[table->count++];
+    entry->dir = dir;
+    entry->name = name;
+    entry->size = sb->st_size;
+    entry->dev = pack_dev(sb->st_dev);
+    entry->ino = sb->st_ino;
+    memset(entry->hash, 0, DIGEST_LEN);
+    entry->processed = 0; // Set processed flag to 0
+    entry->hashed = 0;
+    entry->link = 0;
+    entry->compared = 0;
+}
+
+void table_append(FileTable* dst, FileTable* src) {
+    if (src->count == 0) return;
+    if (dst->count == 0) {
+        // Nothing to merge with: take over src's array instead of copying it
+        free(dst->entries);
+        *dst = *src;
+        src->entries = NULL;
+        src->count = src->capacity = 0;
+        return;
+    }
+
+    table_reserve(dst, dst->count + src->count);
+    memcpy(dst->entries + dst->count, src->entries, sizeof(FileEntry) * src->count);
+    dst->count += src->count;
+    table_free(src);
+}
+
+void table_free(FileTable* table) {
+    free(table->entries);
+    table->entries = NULL;
+    table->count = table->capacity = 0;
+}
+
+int64_t entry_mtime(const FileEntry* entry) {
+    if (!store_mtimes) return 0;
+    return ((const TimedName*)(entry->name - offsetof(TimedName, name)))->mtime_ns;
+}
+
+// Appends "/name" (or just "name" at the start) at buf[pos]; returns the new length
+static int append_component(char* buf, size_t len, int pos, const char* name) {
+    int n = snprintf(buf + pos, len - pos, pos ? "/%s" : "%s", name);
+    if (n < 0 || (size_t)(pos + n) >= len) return -1;
+    return pos + n;
+}
+
+// Writes the directory's path and returns its length, or -1
+static int build_dir_path(const DirNode* dir, char* buf, size_t len) {
+    if (!dir->parent) return append_component(buf, len, 0, dir->name);
+
+    int pos = build_dir_path(dir->parent, buf, len);
+    return pos < 0 ? -1 : append_component(buf, len, pos, dir->name);
+}
+
+int dirnode_path(const DirNode* dir, char* buf, size_t len) {
+    if (build_dir_path(dir, buf, len) < 0) {
+        buf[0] = '\0';
+        return -1;
+    }
+    return 0;
+}
+
+int entry_path(const FileEntry* entry, char* buf, size_t len) {
+    int pos = 0;
+    if ((entry->dir && (pos = build_dir_path(entry->dir, buf, len)) < 0) ||
+        append_component(buf, len, pos, entry->name) < 0) {
+        buf[0] = '\0';
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+//
+//  filestore.h
+//  PA01_FindDups
+//
+//  Compact in-memory storage for scanned files. Names and directory nodes
+//  are bump-allocated from an arena and each directory's path prefix is
+//  stored once, as a chain of (parent, name) nodes. File records live in
+//  one contiguous table.
+//
+#ifndef FILESTORE_H
+#define FILESTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define DIGEST_LEN 32 // Raw SHA-256 digest; compared with memcmp, never as hex
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator; memory is only released all at once by arena_free()
+typedef struct {
+    ArenaBlock* head; // Block being filled; older blocks chain behind it
+} Arena;
+
+// One directory: its full path is parent's path + "/" + name. Roots have
+// no parent and hold the path exactly as given on the command line.
+typedef struct DirNode {
+    const struct DirNode* parent;
+    char name[];
+} DirNode;
+
+// Struct to store file information (72 bytes; the name lives in the arena)
+typedef struct FileEntry {
+    const DirNode* dir; // NULL for files named on the command line
+    const char* name;   // From arena_filename()
+    uint64_t size;
+    uint64_t ino;       // With dev, identifies the file for the digest cache and hardlinks
+    // Holds the head/tail hash after the partial stage and is overwritten
+    // by the full hash; only compared between files at the same stage.
+    unsigned char hash[DIGEST_LEN];
+    uint32_t dev;            // pack_dev(st_dev), so it shares a word with the flags
+    unsigned char processed; // Flag to track if already processed (or not a candidate)
+    unsigned char hashed;    // `hash` is the full-file digest
+    unsigned char link;      // Another name for the inode of the entry before it
+    unsigned char compared;  // `hash` is a byte-compared class key, not a digest
+} FileEntry;
+
+// Contiguous, growable array of entries
+typedef struct {
+    FileEntry* entries;
+    size_t count, capacity;
+} FileTable;
+
+// Device numbers in the kernel's own 32-bit form (12-bit major, 20-bit
+// minor), which holds every st_dev Linux reports
+uint32_t pack_dev(dev_t dev);
+dev_t unpack_dev(uint32_t dev);
+
+// Keep each file's scan-time mtime, for the modes that must tell whether a
+// file changed since the scan (--cache, --reclaim, --watch). Most scans
+// never look at it, so it is stored in the arena just before the file's
+// name, and only when this is set before the scan starts.
+extern int store_mtimes;
+
+void arena_init(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);
+const char* arena_strdup(Arena* arena, const char* s);
+// Copies a file name, with its mtime in front of it if store_mtimes is set
+const char* arena_filename(Arena* arena, const char* name, int64_t mtime_ns);
+const DirNode* arena_dirnode(Arena* arena, const DirNode* parent, const char* name);
+// Moves every block of `src` into `dst`, leaving `src` empty
+void arena_adopt(Arena* dst, Arena* src);
+void arena_free(Arena* arena);
+
+// Appends a new, unhashed entry (the name must already be in an arena)
+void table_add(FileTable* table, const DirNode* dir, const char* name, const struct stat* sb);
+// Appends all of `src` to `dst` and empties `src`
+void table_append(FileTable* dst, FileTable* src);
+void table_free(FileTable* table);
+// The mtime stored with the entry's name; 0 unless store_mtimes is set
+int64_t entry_mtime(const FileEntry* entry);
+
+// Writes the full path of a directory or file into buf. Returns -1 (and
+// leaves an empty string) if it does not fit.
+int dirnode_path(const DirNode* dir, char* buf, size_t len);
+int entry_path(const FileEntry* entry, char* buf, size_t len);
+
+#endif // FILESTORE_H
@@ -0,0 +1,55 @@
+//
+//  finddups.h
+//  PA01_FindDups
+//
+//  Settings shared between main.c, the directory walker (walk.c), the
+//  hashing worker pool (hashpool.c) and the external-memory driver
+//  (spill.c), plus the grouping helpers main.c lends to spill.c.
+//
+#ifndef FINDDUPS_H
+#define FINDDUPS_H
+
+#include <stddef.h>
+#include <limits.h> // Fix PATH_MAX
+
+#include "digest.h"
+#include "filestore.h"
+
+// Files surviving / eliminated at each stage of the candidate pipeline
+typedef struct {
+    long files;          // Regular files found by the scan
+    long size_unique;    // Dropped by the size stage
+    long cache_hits;     // Digest reused from the cache, never read
+    long partial_hashed; // Read head/tail blocks only
+    long partial_unique; // Dropped by the partial-hash stage
+    long full_hashed;    // Read in full by hash_file()
+    long compared;       // Byte-compared in lockstep instead of hashed
+    long compare_unique; // Dropped by the lockstep compare
+    long unreadable;     // Dropped because they could not be read
+    long verify_split;   // Same digest but different bytes (--verify)
+    long links;          // Extra names for an inode that was already found
+    long dup_groups;     // Groups holding at least two distinct inodes
+    long dup_copies;     // Inodes that could be replaced by a link
+    unsigned long long reclaimable; // Bytes those copies occupy
+} StageCounts;
+
+// A run of entries with identical contents, ready to print
+typedef struct {
+    FileEntry** members;
+    int count;
+} DupGroup;
+
+extern StageCounts stage_counts;
+extern size_t partial_block;          // Head/tail block size, 0 disables the stage
+extern const DigestAlgo* digest_algo; // Backend selected with --hash
+extern int nthreads;                  // Hashing threads (-j)
+extern int verify;                    // Byte-compare each group (--verify)
+
+// Splits `count` entries with equal digests into the groups worth
+// reporting: byte-identical classes (with --verify) that span at least two
+// inodes, each sorted by path. Writes them to `groups` (room for count / 2)
+// and returns how many there are; `class_len` needs room for `count`.
+int split_duplicates(FileEntry** members, int count, int* class_len, DupGroup* groups);
+void print_group(const DupGroup* group);
+
+#endif // FINDDUPS_H
@@ -0,0 +1,175 @@
+//
+//  hashpool.c
+//  PA01_FindDups
+//
+//  Bounded producer/consumer queue of hash jobs. The stage driver in
+//  main.c produces jobs; each worker owns a DigestCtx and writes its
+//  digest straight into the FileEntry, so results need no extra locking.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "hashpool.h"
+
+#define JOBS_PER_THREAD 16 // Queue depth per worker; bounds memory use
+
+typedef struct {
+    FileEntry* entry;
+    HashKind kind;
+} HashJob;
+
+struct HashPool {
+    int nthreads;
+    pthread_t* threads;
+    DigestCtx* ctx;    // Only used when running synchronously
+
+    HashJob* queue;    // Ring buffer of `capacity` jobs
+    int capacity;
+    int head, count;   // Next job to take, jobs waiting
+    int pending;       // Jobs submitted but not yet finished
+    int shutdown;
+
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty; // Signalled when a job is queued
+    pthread_cond_t not_full;  // Signalled when a worker takes a job
+    pthread_cond_t idle;      // Signalled when pending drops to zero
+};
+
+// Runs one job with the caller's digest context
+static void run_job(DigestCtx* ctx, HashJob* job) {
+    FileEntry* entry = job->entry;
+    char path[PATH_MAX];
+    int status;
+
+    if (entry_path(entry, path, sizeof(path)) != 0) {
+        fprintf(stderr, "Path too long: %s\n", entry->name);
+        status = -1;
+    } else if (job->kind == HASH_PARTIAL) {
+        status = partial_hash_file(ctx, path, entry->size, partial_block, entry->hash);
+    } else {
+        status = hash_file(ctx, path, entry->hash);
+    }
+    if (status != 0) {
+        entry->processed = 1; // Unreadable: drop it from the pipeline
+    } else if (job->kind == HASH_FULL) {
+        entry->hashed = 1;
+    }
+}
+
+static void* worker(void* arg) {
+    HashPool* pool = arg;
+    DigestCtx* ctx = digest_new(digest_algo);
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->count == 0 && !pool->shutdown) {
+            pthread_cond_wait(&pool->not_empty, &pool->lock);
+        }
+        if (pool->count == 0) break; // Shut down and drained
+
+        HashJob job = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        pthread_cond_signal(&pool->not_full);
+        pthread_mutex_unlock(&pool->lock);
+
+        run_job(ctx, &job);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&pool->idle);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    digest_free(ctx);
+    return NULL;
+}
+
+HashPool* hashpool_create(int nthreads) {
+    HashPool* pool = calloc(1, sizeof(HashPool));
+    if (!pool) {
+        fprintf(stderr, "Memory allocation failed for hash pool\n");
+        exit(EXIT_FAILURE);
+    }
+    pool->nthreads = nthreads < 1 ? 1 : nthreads;
+
+    if (pool->nthreads == 1) {
+        pool->ctx = digest_new(digest_algo);
+        return pool;
+    }
+
+    pool->capacity = pool->nthreads * JOBS_PER_THREAD;
+    pool->queue = malloc(sizeof(HashJob) * pool->capacity);
+    pool->threads = malloc(sizeof(pthread_t) * pool->nthreads);
+    if (!pool->queue || !pool->threads) {
+        fprintf(stderr, "Memory allocation failed for hash pool\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (int i = 0; i < pool->nthreads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker, pool) != 0) {
+            fprintf(stderr, "Failed to start hashing thread %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+void hashpool_submit(HashPool* pool, FileEntry* entry, HashKind kind) {
+    HashJob job = { entry, kind };
+
+    if (pool->nthreads == 1) {
+        run_job(pool->ctx, &job);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->count == pool->capacity) {
+        pthread_cond_wait(&pool->not_full, &pool->lock);
+    }
+    pool->queue[(pool->head + pool->count) % pool->capacity] = job;
+    pool->count++;
+    pool->pending++;
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void hashpool_wait(HashPool* pool) {
+    if (pool->nthreads == 1) return;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void hashpool_destroy(HashPool* pool) {
+    if (pool->nthreads == 1) {
+        digest_free(pool->ctx);
+        free(pool);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_cond_destroy(&pool->not_full);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->queue);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,30 @@
+//
+//  hashpool.h
+//  PA01_FindDups
+//
+//  A pool of hashing threads fed through a bounded work queue.
+//
+#ifndef HASHPOOL_H
+#define HASHPOOL_H
+
+#include "finddups.h"
+
+typedef enum { HASH_PARTIAL, HASH_FULL } HashKind;
+
+typedef struct HashPool HashPool;
+
+// Starts `nthreads` workers. With one thread no workers are started and
+// jobs run synchronously inside hashpool_submit().
+HashPool* hashpool_create(int nthreads);
+
+// Queues a job, blocking while the queue is full. The result is written
+// into the entry's `hash`; if the file cannot be read the entry is marked
+// processed instead.
+void hashpool_submit(HashPool* pool, FileEntry* entry, HashKind kind);
+
+// Waits until every submitted job has finished
+void hashpool_wait(HashPool* pool);
+
+void hashpool_destroy(HashPool* pool);
+
+#endif // HASHPOOL_H
@@ -0,0 +1,318 @@
+//
+//  lockstep.c
+//  PA01_FindDups
+//
+//  Reads a set of files chunk by chunk, side by side, splitting them into
+//  classes as soon as their contents diverge. A file that ends up alone in
+//  its class stops being read, so mismatches usually cost one chunk. Each
+//  file is read at most once per pass.
+//
+//  lockstep_buckets() uses the same comparison as a pipeline stage in place
+//  of hashing: small size buckets are handed out to threads one at a time,
+//  and each byte-identical class gets a synthetic key instead of a digest.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h> // for PATH_MAX
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "lockstep.h"
+#include "stats.h"
+
+#define LOCKSTEP_CHUNK (128 * 1024)
+#define LOCKSTEP_MAX_FILES 64 // Bounds open descriptors and buffer memory
+#define KEY_FILL 0xff         // Pads class keys; xxh64 digests are zero-padded instead
+
+typedef struct {
+    FileEntry* entry;
+    int index;    // Position in the caller's array, for a stable order
+    int fd;
+    int cls;      // Current class
+    int done;     // Alone in its class, at EOF, or failed
+    ssize_t len;  // Bytes in buf from the last round
+    unsigned char* buf;
+} Member;
+
+// Fills buf as far as possible, so short reads cannot split a class
+static ssize_t read_chunk(int fd, unsigned char* buf, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(fd, buf + got, size - got);
+        count_read(n);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        got += n;
+    }
+    return got;
+}
+
+static int compare_members_by_class(const void* a, const void* b) {
+    const Member* memberA = a;
+    const Member* memberB = b;
+    if (memberA->cls != memberB->cls) return memberA->cls - memberB->cls;
+    return memberA->index - memberB->index;
+}
+
+// Marks a member unreadable: it leaves the comparison in a class of its own
+static void drop_member(Member* member, int* nclasses) {
+    member->cls = (*nclasses)++;
+    member->done = 1;
+    member->entry->processed = 1;
+}
+
+// Partitions at most LOCKSTEP_MAX_FILES files; see lockstep_partition()
+static int partition_batch(FileEntry** members, int count, int* class_len) {
+    Member* m = calloc(count, sizeof(Member));
+    unsigned char* bufs = malloc((size_t)count * LOCKSTEP_CHUNK);
+    // Class numbers are never reused. Splits refine the partition, so
+    // they add at most count - 1 numbers; each file is dropped at most
+    // once, adding at most count more; class 0 makes 2 * count.
+    int* size_of = malloc(sizeof(int) * 2 * count);
+    int* founders = malloc(sizeof(int) * 2 * count);
+    if (!m || !bufs || !size_of || !founders) {
+        fprintf(stderr, "Memory allocation failed for byte comparison\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int nclasses = 1;
+    for (int i = 0; i < count; i++) {
+        char path[PATH_MAX];
+        m[i].entry = members[i];
+        m[i].index = i;
+        m[i].buf = bufs + (size_t)i * LOCKSTEP_CHUNK;
+        m[i].fd = entry_path(members[i], path, sizeof(path)) == 0 ? open(path, O_RDONLY) : -1;
+        if (m[i].fd < 0) {
+            fprintf(stderr, "Cannot open file %s: %s\n", path, strerror(errno));
+            drop_member(&m[i], &nclasses);
+        } else {
+            count_open();
+        }
+    }
+
+    for (;;) {
+        int active = 0;
+        for (int i = 0; i < count; i++) {
+            if (m[i].done) continue;
+            if ((m[i].len = read_chunk(m[i].fd, m[i].buf, LOCKSTEP_CHUNK)) < 0) {
+                char path[PATH_MAX];
+                entry_path(m[i].entry, path, sizeof(path));
+                fprintf(stderr, "Cannot read file %s: %s\n", path, strerror(errno));
+                drop_member(&m[i], &nclasses);
+                continue;
+            }
+            active++;
+        }
+        if (active == 0) break;
+
+        // Split every class by this round's chunk. The first member of a
+        // class keeps its number; a member that matches none of the
+        // sub-class founders so far founds a new class.
+        int old_classes = nclasses;
+        for (int c = 0; c < old_classes; c++) {
+            int nfounders = 0;
+            for (int i = 0; i < count; i++) {
+                if (m[i].done || m[i].cls != c) continue;
+                int f;
+                for (f = 0; f < nfounders; f++) {
+                    Member* founder = &m[founders[f]];
+                    if (founder->len == m[i].len && memcmp(founder->buf, m[i].buf, m[i].len) == 0) break;
+                }
+                if (f < nfounders) {
+                    m[i].cls = m[founders[f]].cls;
+                } else {
+                    if (nfounders > 0) m[i].cls = nclasses++;
+                    founders[nfounders++] = i;
+                }
+            }
+        }
+
+        // Stop reading files that reached EOF or have nobody left to match
+        for (int c = 0; c < nclasses; c++) size_of[c] = 0;
+        for (int i = 0; i < count; i++) {
+            if (!m[i].done) size_of[m[i].cls]++;
+        }
+        for (int i = 0; i < count; i++) {
+            if (!m[i].done && (m[i].len == 0 || size_of[m[i].cls] < 2)) m[i].done = 1;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (m[i].fd >= 0) close(m[i].fd);
+    }
+
+    // Make classes contiguous and renumber them in order
+    qsort(m, count, sizeof(Member), compare_members_by_class);
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        members[i] = m[i].entry;
+        if (i == 0 || m[i].cls != m[i - 1].cls) class_len[n++] = 0;
+        class_len[n - 1]++;
+    }
+
+    free(m);
+    free(bufs);
+    free(size_of);
+    free(founders);
+    return n;
+}
+
+int lockstep_partition(FileEntry** members, int count, int* class_len) {
+    if (count <= LOCKSTEP_MAX_FILES) return partition_batch(members, count, class_len);
+
+    // Too many to hold open at once: compare the first file against the
+    // others a batch at a time. Files matching it are compacted to the
+    // front; files that differ are partitioned afterwards the same way.
+    FileEntry** differ = malloc(sizeof(FileEntry*) * count);
+    if (!differ) {
+        fprintf(stderr, "Memory allocation failed for byte comparison\n");
+        exit(EXIT_FAILURE);
+    }
+    FileEntry* ref = members[0];
+    FileEntry* batch[LOCKSTEP_MAX_FILES];
+    int batch_len[LOCKSTEP_MAX_FILES];
+    int same = 1, ndiffer = 0, next = 1;
+
+    while (next < count) {
+        int k = 1;
+        batch[0] = ref;
+        while (k < LOCKSTEP_MAX_FILES && next < count) batch[k++] = members[next++];
+        int nbatch = partition_batch(batch, k, batch_len);
+
+        if (ref->processed) {
+            // The reference is unreadable: it is a class of its own
+            for (int i = 1; i < same; i++) differ[ndiffer++] = members[i];
+            for (int i = 0; i < k; i++) {
+                if (batch[i] != ref) differ[ndiffer++] = batch[i];
+            }
+            for (int i = next; i < count; i++) differ[ndiffer++] = members[i];
+            memcpy(members + 1, differ, sizeof(FileEntry*) * ndiffer);
+            free(differ);
+            class_len[0] = 1;
+            return 1 + lockstep_partition(members + 1, count - 1, class_len + 1);
+        }
+
+        // same <= next - (k - 1) here, so compacting never overwrites
+        // members that are still waiting for a batch
+        int pos = 0;
+        for (int c = 0; c < nbatch; c++) {
+            int has_ref = 0;
+            for (int i = pos; i < pos + batch_len[c]; i++) {
+                if (batch[i] == ref) has_ref = 1;
+            }
+            for (int i = pos; i < pos + batch_len[c]; i++) {
+                if (batch[i] == ref) continue;
+                if (has_ref) members[same++] = batch[i];
+                else differ[ndiffer++] = batch[i];
+            }
+            pos += batch_len[c];
+        }
+    }
+
+    // Readable leftovers are partitioned again; unreadable ones are final
+    class_len[0] = same;
+    int nclasses = 1, nread = 0;
+    for (int i = 0; i < ndiffer; i++) {
+        if (!differ[i]->processed) members[same + nread++] = differ[i];
+    }
+    int pos = same + nread;
+    for (int i = 0; i < ndiffer; i++) {
+        if (differ[i]->processed) members[pos++] = differ[i];
+    }
+    if (nread > 0) nclasses += lockstep_partition(members + same, nread, class_len + 1);
+    for (int i = nread; i < ndiffer; i++) class_len[nclasses++] = 1;
+
+    free(differ);
+    return nclasses;
+}
+
+// Source of class keys, shared by every call so keys never repeat
+static atomic_ullong next_key;
+
+typedef struct {
+    FileEntry** list;
+    const int* bounds;
+    int nbuckets;
+    atomic_int next;       // Next bucket to claim
+    atomic_int unique;
+    atomic_int unreadable;
+} BucketWork;
+
+// Partitions one bucket and tags its classes
+static void compare_bucket(BucketWork* w, FileEntry** members, int count) {
+    int* class_len = malloc(sizeof(int) * count);
+    if (!class_len) {
+        fprintf(stderr, "Memory allocation failed for byte comparison\n");
+        exit(EXIT_FAILURE);
+    }
+    int nclasses = lockstep_partition(members, count, class_len);
+
+    for (int c = 0; c < nclasses; c++) {
+        if (class_len[c] == 1) {
+            if (members[0]->processed) {
+                atomic_fetch_add(&w->unreadable, 1);
+            } else {
+                members[0]->processed = 1; // Differs from every other file
+                atomic_fetch_add(&w->unique, 1);
+            }
+        } else {
+            unsigned long long key = atomic_fetch_add(&next_key, 1);
+            for (int i = 0; i < class_len[c]; i++) {
+                memset(members[i]->hash, KEY_FILL, DIGEST_LEN);
+                memcpy(members[i]->hash, &key, sizeof(key));
+                members[i]->compared = 1;
+            }
+        }
+        members += class_len[c];
+    }
+    free(class_len);
+}
+
+static void* bucket_worker(void* arg) {
+    BucketWork* w = arg;
+    int b;
+    while ((b = atomic_fetch_add(&w->next, 1)) < w->nbuckets) {
+        compare_bucket(w, w->list + w->bounds[b], w->bounds[b + 1] - w->bounds[b]);
+    }
+    return NULL;
+}
+
+int lockstep_buckets(FileEntry** list, const int* bounds, int nbuckets, int nthreads,
+                     int* unreadable) {
+    BucketWork w;
+    w.list = list;
+    w.bounds = bounds;
+    w.nbuckets = nbuckets;
+    atomic_init(&w.next, 0);
+    atomic_init(&w.unique, 0);
+    atomic_init(&w.unreadable, 0);
+
+    int n = nthreads < nbuckets ? nthreads : nbuckets;
+    if (n <= 1) {
+        bucket_worker(&w);
+    } else {
+        pthread_t* tids = malloc(sizeof(pthread_t) * n);
+        if (!tids) {
+            fprintf(stderr, "Memory allocation failed for byte comparison threads\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < n; i++) {
+            if (pthread_create(&tids[i], NULL, bucket_worker, &w) != 0) {
+                fprintf(stderr, "Cannot start byte comparison thread\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (int i = 0; i < n; i++) pthread_join(tids[i], NULL);
+        free(tids);
+    }
+
+    *unreadable = atomic_load(&w.unreadable);
+    return atomic_load(&w.unique);
+}
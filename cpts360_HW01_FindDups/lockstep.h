@@ -0,0 +1,28 @@
+//
+//  lockstep.h
+//  PA01_FindDups
+//
+//  Byte-for-byte comparison of several files at once.
+//
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "filestore.h"
+
+// Partitions `members` into classes of byte-identical files. On return
+// the members are reordered so each class is contiguous, class_len[c] is
+// the size of class c, and the number of classes is returned. class_len
+// needs room for `count` classes. A file that cannot be read ends up in a
+// class of its own and is marked processed.
+int lockstep_partition(FileEntry** members, int count, int* class_len);
+
+// Byte-compares `nbuckets` buckets of candidates on `nthreads` threads;
+// bucket b is list[bounds[b]] .. list[bounds[b + 1] - 1]. A file left
+// alone in its class is marked processed. The members of every other class
+// share a key in `hash`, unique across calls, and are flagged compared, so
+// find_duplicates() groups them like equal digests. Returns how many files
+// were found unique; *unreadable counts those that could not be read.
+int lockstep_buckets(FileEntry** list, const int* bounds, int nbuckets, int nthreads,
+                     int* unreadable);
+
+#endif // LOCKSTEP_H
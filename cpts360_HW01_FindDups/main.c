@@ -7,204 +7,659 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 #include <sys/stat.h>
-#include <openssl/evp.h> // Replaces deprecated SHA256 functions
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
 #include <limits.h> // Fix PATH_MAX
+#include <getopt.h>
 
-#define HASH_SIZE 65 // SHA256 hash is 64 hex characters + null terminator
+#include "finddups.h"
+#include "chunks.h"
+#include "digestcache.h"
+#include "hashpool.h"
+#include "lockstep.h"
+#include "reclaim.h"
+#include "spill.h"
+#include "stats.h"
+#include "walk.h"
+#include "watch.h"
 
-// Struct to store file information
-typedef struct FileEntry {
-    char path[PATH_MAX];
-    size_t size;
-    char hash[HASH_SIZE];
-    int processed; // Flag to track if already processed
-    struct FileEntry* next;
-} FileEntry;
+#define DEFAULT_PARTIAL_KIB 4 // Head/tail block size for the partial-hash stage
+#define DEFAULT_LOCKSTEP_FILES 4 // Buckets this small are byte-compared, not hashed
+#define DEFAULT_MEM_LIMIT_MIB 256 // Memory budget with --spill-dir
+#define MIN_MEM_LIMIT_MIB 16
+#define DEFAULT_PROGRESS_SECONDS 10 // --progress without an interval
+#define DEFAULT_CHUNK_PAIRS 20 // --chunks without a pair count
+
+// Every regular file found, plus the arena holding their names
+FileTable file_table;
+Arena name_arena;
 
-// Head of linked list storing file entries
-FileEntry* file_list = NULL;
+StageCounts stage_counts;
+WalkStats walk_stats;
+
+size_t partial_block = DEFAULT_PARTIAL_KIB * 1024; // 0 disables the stage
+int verbose = 0;
+int stats_format = 0;  // --stats: 0 off, 1 text, 2 JSON
+int progress_seconds = 0; // --progress interval, 0 for none
+int nthreads = 1; // Hashing threads (-j)
+int verify = 0;   // Byte-compare members of each group before reporting
+int lockstep_files = DEFAULT_LOCKSTEP_FILES; // 0 hashes every bucket
+const DigestAlgo* digest_algo;
+const char* cache_path = NULL; // Digest cache file (-c), NULL for none
+DigestCache* digest_cache = NULL;
+const char* spill_dir = NULL; // External-memory mode (--spill-dir), NULL for none
+size_t mem_limit = (size_t)DEFAULT_MEM_LIMIT_MIB * 1024 * 1024;
+const char* watch_socket = NULL; // Watch mode (--watch), NULL for a single scan
+int chunk_pairs = 0; // Chunking mode (--chunks): file pairs to list, 0 for off
 
 // Function prototypes
-void scan_directory(const char* dir_path);
-int hash_file(const char* filename, char* outputBuffer);
-void add_file(const char* path, size_t size, const char* hash);
+void hash_candidates();
 void find_duplicates();
+void print_stage_counts();
 int compare_paths(const void* a, const void* b);
-void free_file_list();
+int compare_entry_sizes(const void* a, const void* b);
+int compare_sizes(const void* a, const void* b);
+int compare_partials(const void* a, const void* b);
+int compare_digests(const void* a, const void* b);
+void free_file_table();
+
+static void usage(const char* progname) {
+    fprintf(stderr, "usage: %s [-v] [-j N] [-p KiB] [-c FILE] [--hash=NAME] [--verify]\n"
+                    "       [--mmap] [--keep-cache] [--stat-all] [--spill-dir=DIR [--mem-limit=MiB]]\n"
+                    "       [--lockstep=N] [--reclaim=MODE] [--stats[=json]] [--progress[=SECONDS]]\n"
+                    "       [--watch=SOCKET] [--chunks[=TOP]] [path...]\n"
+                    "  -c, --cache=FILE    reuse and update digests stored in FILE\n"
+                    "      --chunks[=TOP]  report data shared between files by content-defined chunks:\n"
+                    "                      the TOP file pairs (default %d) and each directory's dedup ratio\n"
+                    "  -H, --hash=NAME     digest backend: %s (default sha256)\n"
+                    "  -j, --threads=N     hash with N threads (default 1)\n"
+                    "      --keep-cache    leave hashed files in the page cache\n"
+                    "      --lockstep=N    byte-compare buckets of up to N files instead of hashing\n"
+                    "                      them (default %d, 0 disables)\n"
+                    "      --mem-limit=MiB memory budget for --spill-dir (default %d)\n"
+                    "      --mmap          hash through mmap() instead of 1 MiB reads\n"
+                    "      --reclaim=MODE  after a byte compare, replace the copies in each group with\n"
+                    "                      reflinks or hardlinks to its first file (reflink, hardlink)\n"
+                    "      --spill-dir=DIR sort through runs on disk in DIR when the file list does\n"
+                    "                      not fit in memory; groups are printed in digest order\n"
+                    "      --stat-all      stat every directory entry instead of trusting d_type\n"
+                    "      --stats[=json]  report phase times, I/O and stage counts on stderr\n"
+                    "  -p, --partial=KiB   head/tail block size for the partial-hash stage "
+                    "(default %d, 0 disables)\n"
+                    "      --progress[=S]  print a progress line on stderr every S seconds (default %d)\n"
+                    "  -v, --verbose       report per-stage candidate counts on stderr\n"
+                    "  -V, --verify        byte-compare the files in each group before reporting\n"
+                    "      --watch=SOCKET  after the scan, keep the groups current with inotify and\n"
+                    "                      answer 'groups', 'dups PATH' and 'stats' on SOCKET\n",
+            progname, DEFAULT_CHUNK_PAIRS, digest_names(), DEFAULT_LOCKSTEP_FILES, DEFAULT_MEM_LIMIT_MIB,
+            DEFAULT_PARTIAL_KIB, DEFAULT_PROGRESS_SECONDS);
+    exit(EXIT_FAILURE);
+}
+
+static const struct option long_options[] = {
+    { "cache",   required_argument, NULL, 'c' },
+    { "chunks",  optional_argument, NULL, 'C' },
+    { "hash",    required_argument, NULL, 'H' },
+    { "keep-cache", no_argument,    &read_mode.keep_cache, 1 },
+    { "lockstep", required_argument, NULL, 'L' },
+    { "mem-limit", required_argument, NULL, 'M' },
+    { "mmap",    no_argument,       &read_mode.use_mmap, 1 },
+    { "threads", required_argument, NULL, 'j' },
+    { "partial", required_argument, NULL, 'p' },
+    { "progress", optional_argument, NULL, 'P' },
+    { "reclaim", required_argument, NULL, 'R' },
+    { "spill-dir", required_argument, NULL, 'S' },
+    { "stat-all", no_argument,      &walk_stat_all, 1 },
+    { "stats",   optional_argument, NULL, 'T' },
+    { "verbose", no_argument,       NULL, 'v' },
+    { "verify",  no_argument,       NULL, 'V' },
+    { "watch",   required_argument, NULL, 'W' },
+    { NULL, 0, NULL, 0 }
+};
 
 int main(int argc, char* argv[]) {
+    int ch;
+    digest_algo = digest_lookup("sha256");
+    while ((ch = getopt_long(argc, argv, "c:H:j:p:vV", long_options, NULL)) != -1) {
+        switch (ch) {
+        case 0:
+            break; // Long option that only sets a flag
+        case 'c':
+            cache_path = optarg;
+            break;
+        case 'C': {
+            char* end;
+            long n = optarg ? strtol(optarg, &end, 10) : DEFAULT_CHUNK_PAIRS;
+            if ((optarg && *end != '\0') || n < 1 || n > 1000000) usage(argv[0]);
+            chunk_pairs = (int)n;
+            break;
+        }
+        case 'H':
+            if (!(digest_algo = digest_lookup(optarg))) {
+                fprintf(stderr, "Unknown hash %s (choose from %s)\n", optarg, digest_names());
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'j': {
+            char* end;
+            long n = strtol(optarg, &end, 10);
+            if (*end != '\0' || n < 1 || n > 1024) usage(argv[0]);
+            nthreads = (int)n;
+            break;
+        }
+        case 'L': {
+            char* end;
+            long n = strtol(optarg, &end, 10);
+            if (*end != '\0' || n < 0 || n > 64) usage(argv[0]);
+            lockstep_files = (int)n;
+            break;
+        }
+        case 'M': {
+            char* end;
+            long mib = strtol(optarg, &end, 10);
+            if (*end != '\0' || mib < MIN_MEM_LIMIT_MIB) usage(argv[0]);
+            mem_limit = (size_t)mib * 1024 * 1024;
+            break;
+        }
+        case 'p': {
+            char* end;
+            long kib = strtol(optarg, &end, 10);
+            if (*end != '\0' || kib < 0) usage(argv[0]);
+            partial_block = (size_t)kib * 1024;
+            break;
+        }
+        case 'P': {
+            char* end;
+            long s = optarg ? strtol(optarg, &end, 10) : DEFAULT_PROGRESS_SECONDS;
+            if ((optarg && *end != '\0') || s < 1) usage(argv[0]);
+            progress_seconds = (int)s;
+            break;
+        }
+        case 'R':
+            if ((reclaim_mode = reclaim_lookup(optarg)) == RECLAIM_NONE) {
+                fprintf(stderr, "Unknown reclaim mode %s (choose from reflink, hardlink)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'S':
+            spill_dir = optarg;
+            break;
+        case 'T':
+            if (!optarg) {
+                stats_format = 1;
+            } else if (strcmp(optarg, "json") == 0) {
+                stats_format = 2;
+            } else {
+                usage(argv[0]);
+            }
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'V':
+            verify = 1;
+            break;
+        case 'W':
+            watch_socket = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    // Reject conflicting options before any scanning or watching starts
+    if (watch_socket && (spill_dir || reclaim_mode != RECLAIM_NONE)) {
+        fprintf(stderr, "--watch cannot be combined with --spill-dir or --reclaim\n");
+        exit(EXIT_FAILURE);
+    }
+    if (chunk_pairs && (spill_dir || watch_socket || reclaim_mode != RECLAIM_NONE || cache_path)) {
+        fprintf(stderr, "--chunks cannot be combined with --spill-dir, --watch, --reclaim or --cache\n");
+        exit(EXIT_FAILURE);
+    }
+    if (spill_dir && cache_path) {
+        fprintf(stderr, "--cache cannot be combined with --spill-dir\n");
+        exit(EXIT_FAILURE);
+    }
+
+    store_mtimes = cache_path || reclaim_mode != RECLAIM_NONE || watch_socket;
+
     // If no arguments, scan current directory
-    if (argc == 1) {
-        scan_directory(".");
+    char* roots[argc + 1];
+    int nroots = 0;
+    if (optind == argc) {
+        roots[nroots++] = ".";
     } else {
-        for (int i = 1; i < argc; i++) {
+        for (int i = optind; i < argc; i++) {
             struct stat sb;
             if (stat(argv[i], &sb) == 0) {
                 if (S_ISDIR(sb.st_mode)) {
-                    scan_directory(argv[i]);
+                    roots[nroots++] = argv[i];
                 } else if (S_ISREG(sb.st_mode)) {
-                    char hash[HASH_SIZE];
-                    if (hash_file(argv[i], hash) == 0) {
-                        add_file(argv[i], sb.st_size, hash);
-                    }
+                    int64_t mtime_ns = (int64_t)sb.st_mtim.tv_sec * 1000000000 + sb.st_mtim.tv_nsec;
+                    table_add(&file_table, NULL, arena_filename(&name_arena, argv[i], mtime_ns), &sb);
                 }
             } else {
                 fprintf(stderr, "Error accessing %s: %s\n", argv[i], strerror(errno));
             }
         }
     }
+    if (watch_socket) {
+        lockstep_files = 0; // The index needs real digests
+        watch_start(roots, nroots);
+    }
 
-    find_duplicates();
-    free_file_list(); //Free memory before exiting
+    if (progress_seconds) progress_start(progress_seconds);
+    if (spill_dir) {
+        spill_find_duplicates(roots, nroots, &file_table, spill_dir, mem_limit, &walk_stats);
+    } else {
+        phase_begin(PHASE_SCAN);
+        walk_directories(roots, nroots, nthreads, &file_table, &name_arena, &walk_stats);
+        phase_end(PHASE_SCAN);
+    }
+    if (chunk_pairs) {
+        chunk_report(&file_table, chunk_pairs, nthreads);
+    } else if (!spill_dir) {
+        if (cache_path) digest_cache = cache_open(cache_path, digest_name(digest_algo));
+        hash_candidates(); // Only same-size files are ever hashed
+        if (digest_cache) {
+            cache_save(cache_path, digest_name(digest_algo), &file_table);
+            cache_close(digest_cache);
+        }
+        find_duplicates();
+    }
+    progress_stop();
+    if (verbose || stats_format == 1) print_stage_counts();
+    if (stats_format == 1) print_phase_stats(&walk_stats);
+    if (stats_format == 2) print_stats_json(&walk_stats);
+    if (watch_socket) {
+        fflush(stdout);
+        watch_run(&file_table, watch_socket);
+    }
+    if (reclaim_mode != RECLAIM_NONE) print_reclaim_stats();
+    free_file_table(); //Free memory before exiting
     return 0;
 }
 
-// Recursively scans directories
-void scan_directory(const char* dir_path) {
-    DIR* dir = opendir(dir_path);
-    if (!dir) {
-        fprintf(stderr, "Cannot open directory %s: %s\n", dir_path, strerror(errno));
-        return;
+// Hashes every entry in `list` on the pool and waits for the results.
+// Entries that could not be read come back marked processed and are
+// dropped from the list; the number of survivors is returned.
+static int hash_stage(HashPool* pool, FileEntry** list, int count, HashKind kind) {
+    for (int i = 0; i < count; i++) {
+        hashpool_submit(pool, list[i], kind);
     }
+    hashpool_wait(pool);
 
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
-            continue;
-
-        char full_path[PATH_MAX]; // Fix for PATH_MAX error
-        snprintf(full_path, sizeof(full_path), "%s/%s", dir_path, entry->d_name);
-
-        struct stat sb;
-        if (stat(full_path, &sb) == 0) {
-            if (S_ISDIR(sb.st_mode)) {
-                scan_directory(full_path);
-            } else if (S_ISREG(sb.st_mode)) {
-                char hash[HASH_SIZE];
-                if (hash_file(full_path, hash) == 0) {
-                    add_file(full_path, sb.st_size, hash);
-                }
-            }
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (list[i]->processed) {
+            stage_counts.unreadable++;
         } else {
-            fprintf(stderr, "Error accessing %s: %s\n", full_path, strerror(errno));
+            list[n++] = list[i];
         }
     }
+    return n;
+}
+
+// Stage a size bucket goes to after the size stage
+enum { ROUTE_COMPARE, ROUTE_PARTIAL, ROUTE_FULL, ROUTE_COUNT };
 
-    closedir(dir);
+static int route_bucket(const FileEntry* bucket, size_t count, size_t inodes, int max_compare) {
+    // Cached digests are final. If any member of the bucket has one, the
+    // others must be hashed in full to be comparable with it.
+    for (size_t i = 0; i < count; i++) {
+        if (bucket[i].hashed) return ROUTE_FULL;
+    }
+    if (partial_block > 0 && bucket[0].size > 2 * partial_block) return ROUTE_PARTIAL;
+    return inodes <= (size_t)max_compare ? ROUTE_COMPARE : ROUTE_FULL;
 }
 
-// Computes SHA-256 hash of a file using OpenSSL EVP API
-int hash_file(const char* filename, char* outputBuffer) {
-    unsigned char hash[EVP_MAX_MD_SIZE]; // Buffer to store hash output
-    unsigned int hash_len;
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
-        fprintf(stderr, "Cannot open file %s: %s\n", filename, strerror(errno));
-        return -1;
+// Runs the candidate pipeline: files are grouped by size, same-size files
+// are split by a cheap head/tail hash, and only the survivors are hashed in
+// full. A file eliminated at any stage cannot have a duplicate, so it is
+// marked processed and never read again. Each hashing stage is fanned out
+// to the worker pool. Files found in the digest cache skip both hashing
+// stages. Hardlinks are collapsed first: only one name per inode goes
+// through the pipeline, and the others copy its result at the end.
+//
+// A bucket of at most `lockstep_files` inodes (by size, or by size and
+// head/tail hash for large files) is byte-compared in lockstep instead of
+// hashed in full: mismatches usually show in the first chunk, so reading
+// stops early. Its files get class keys rather than digests. With a digest
+// cache every bucket is hashed, so the next scan can reuse the results.
+void hash_candidates() {
+    FileEntry* by_size = file_table.entries;
+    size_t n = file_table.count;
+    stage_counts.files = n;
+    if (n == 0) return;
+    phase_begin(PHASE_HASH);
+
+    // Stage 1: size. The table itself is sorted, so buckets are contiguous
+    // and the names of one inode are adjacent inside them
+    qsort(by_size, n, sizeof(FileEntry), compare_entry_sizes);
+    for (size_t i = 1; i < n; i++) {
+        if (by_size[i].dev == by_size[i - 1].dev && by_size[i].ino == by_size[i - 1].ino) {
+            by_size[i].link = 1;
+            stage_counts.links++;
+        }
     }
+    // First pass: look up the cache and count the files routed to each
+    // stage, so one array can hold all of them
+    int max_compare = digest_cache ? 0 : lockstep_files;
+    size_t routed[ROUTE_COUNT] = { 0 };
+    size_t start = 0;
+    while (start < n) {
+        size_t end = start + 1;
+        size_t inodes = 1;
+        for (; end < n && by_size[end].size == by_size[start].size; end++) {
+            if (!by_size[end].link) inodes++;
+        }
 
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    if (!mdctx) {
-        fprintf(stderr, "Failed to create EVP_MD_CTX\n");
-        fclose(file);
-        return -1;
+        if (inodes < 2) {
+            // Unique size, or only names for one inode: not a candidate
+            for (size_t i = start; i < end; i++) by_size[i].processed = 1;
+            stage_counts.size_unique += end - start;
+            start = end;
+            continue;
+        }
+        for (size_t i = start; digest_cache && i < end; i++) {
+            if (by_size[i].link) continue;
+            if (cache_lookup(digest_cache, &by_size[i])) {
+                by_size[i].hashed = 1;
+                stage_counts.cache_hits++;
+            }
+        }
+        int route = route_bucket(&by_size[start], end - start, inodes, max_compare);
+        for (size_t i = start; i < end; i++) {
+            if (!by_size[i].hashed && !by_size[i].link) routed[route]++;
+        }
+        start = end;
     }
 
-    EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL);
+    // The array is laid out as [compare | partial | full]. The partial stage
+    // moves its survivors into the other two parts, so no file is ever in
+    // more than one list.
+    size_t n_listed = routed[ROUTE_COMPARE] + routed[ROUTE_PARTIAL] + routed[ROUTE_FULL];
+    FileEntry** list = malloc(sizeof(FileEntry*) * (n_listed + 1));
+    int* compare_bounds = malloc(sizeof(int) * (n_listed / 2 + 1)); // Buckets have 2+ files
+    if (!list || !compare_bounds) {
+        fprintf(stderr, "Memory allocation failed for size grouping\n");
+        exit(EXIT_FAILURE);
+    }
+    FileEntry** partial_list = list + routed[ROUTE_COMPARE];
+    FileEntry** full_list = partial_list + routed[ROUTE_PARTIAL];
+    int n_partial = 0, n_full = 0, n_compare = 0, n_buckets = 0;
+    compare_bounds[0] = 0;
+    start = 0;
+    while (start < n) {
+        size_t end = start + 1;
+        size_t inodes = 1;
+        for (; end < n && by_size[end].size == by_size[start].size; end++) {
+            if (!by_size[end].link) inodes++;
+        }
+        if (by_size[start].processed) {
+            start = end;
+            continue;
+        }
 
-    char buffer[4096];
-    size_t bytesRead;
-    while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
-        EVP_DigestUpdate(mdctx, buffer, bytesRead);
+        int route = route_bucket(&by_size[start], end - start, inodes, max_compare);
+        for (size_t i = start; i < end; i++) {
+            if (by_size[i].hashed || by_size[i].link) continue;
+            if (route == ROUTE_PARTIAL) {
+                partial_list[n_partial++] = &by_size[i];
+            } else if (route == ROUTE_COMPARE) {
+                list[n_compare++] = &by_size[i];
+            } else {
+                full_list[n_full++] = &by_size[i]; // Partial hash would read it all anyway
+            }
+        }
+        if (n_compare > compare_bounds[n_buckets]) compare_bounds[++n_buckets] = n_compare;
+        start = end;
     }
 
-    EVP_DigestFinal_ex(mdctx, hash, &hash_len);
-    EVP_MD_CTX_free(mdctx);
-    fclose(file);
+    HashPool* pool = hashpool_create(nthreads);
+
+    // Stage 2: head/tail hash, then split each size bucket by it
+    n_partial = hash_stage(pool, partial_list, n_partial, HASH_PARTIAL);
+    stage_counts.partial_hashed = n_partial;
+    qsort(partial_list, n_partial, sizeof(FileEntry*), compare_partials);
+    int run = 0;
+    while (run < n_partial) {
+        int end = run + 1;
+        while (end < n_partial && compare_partials(&partial_list[run], &partial_list[end]) == 0) end++;
 
-    // Convert hash bytes to hex string
-    for (unsigned int i = 0; i < hash_len; i++) {
-        sprintf(outputBuffer + (i * 2), "%02x", hash[i]);
+        for (int i = run; i < end; i++) {
+            FileEntry* entry = partial_list[i];
+            if (end - run < 2) {
+                entry->processed = 1; // Head or tail differs from every other file
+                stage_counts.partial_unique++;
+            } else if (end - run <= max_compare) {
+                // Swap it to the end of the compare part; everything in
+                // between has already left this stage
+                partial_list[i] = list[n_compare];
+                list[n_compare++] = entry;
+            }
+        }
+        if (n_compare > compare_bounds[n_buckets]) compare_bounds[++n_buckets] = n_compare;
+        run = end;
     }
-    outputBuffer[HASH_SIZE - 1] = '\0';
-    return 0;
+    // What is left of the partial part goes to the full hash: move it down
+    // against the full part, from the top so nothing is overwritten
+    for (FileEntry** p = partial_list + n_partial; p-- > list + n_compare;) {
+        if (!(*p)->processed) {
+            *--full_list = *p;
+            n_full++;
+        }
+    }
+
+    // Stage 3: full hash, or a lockstep byte compare for small buckets
+    stage_counts.full_hashed = hash_stage(pool, full_list, n_full, HASH_FULL);
+    int unreadable = 0;
+    stage_counts.compared = n_compare;
+    stage_counts.compare_unique = lockstep_buckets(list, compare_bounds, n_buckets,
+                                                   nthreads, &unreadable);
+    stage_counts.unreadable += unreadable;
+    stage_counts.compared -= unreadable;
+
+    // Every link follows its inode's first name in the table
+    for (size_t i = 1; i < n; i++) {
+        if (!by_size[i].link) continue;
+        memcpy(by_size[i].hash, by_size[i - 1].hash, DIGEST_LEN);
+        by_size[i].processed = by_size[i - 1].processed;
+        by_size[i].hashed = by_size[i - 1].hashed;
+        by_size[i].compared = by_size[i - 1].compared;
+    }
+
+    hashpool_destroy(pool);
+    free(list);
+    free(compare_bounds);
+    phase_end(PHASE_HASH);
 }
 
-// Adds a file to linked list
-void add_file(const char* path, size_t size, const char* hash) {
-    FileEntry* new_entry = malloc(sizeof(FileEntry));
-    if (!new_entry) {
-        fprintf(stderr, "Memory allocation failed for %s\n", path);
-        return;
+// Prints how many files each stage of the pipeline eliminated
+void print_stage_counts() {
+    fprintf(stderr, "files scanned:            %ld\n", stage_counts.files);
+    fprintf(stderr, "directories read:         %ld (%ld getdents64, %ld stat calls)\n",
+            walk_stats.dirs, walk_stats.getdents, walk_stats.stats);
+    fprintf(stderr, "eliminated by size:       %ld\n", stage_counts.size_unique);
+    fprintf(stderr, "digest cache hits:        %ld\n", stage_counts.cache_hits);
+    fprintf(stderr, "partially hashed:         %ld (%zu KiB head + tail)\n",
+            stage_counts.partial_hashed, partial_block / 1024);
+    fprintf(stderr, "eliminated by head/tail:  %ld\n", stage_counts.partial_unique);
+    fprintf(stderr, "fully hashed:             %ld\n", stage_counts.full_hashed);
+    fprintf(stderr, "byte-compared:            %ld (buckets of up to %d files)\n",
+            stage_counts.compared, lockstep_files);
+    fprintf(stderr, "eliminated by compare:    %ld\n", stage_counts.compare_unique);
+    fprintf(stderr, "unreadable:               %ld\n", stage_counts.unreadable);
+    if (verify) {
+        fprintf(stderr, "split by byte compare:    %ld\n", stage_counts.verify_split);
     }
-    strncpy(new_entry->path, path, PATH_MAX);
-    new_entry->size = size;
-    strncpy(new_entry->hash, hash, HASH_SIZE);
-    new_entry->processed = 0; // Set processed flag to 0
-    new_entry->next = file_list;
-    file_list = new_entry;
+    fprintf(stderr, "already hardlinked:       %ld names\n", stage_counts.links);
+    fprintf(stderr, "duplicate groups:         %ld (%ld redundant copies)\n",
+            stage_counts.dup_groups, stage_counts.dup_copies);
+    fprintf(stderr, "reclaimable:              %llu bytes\n", stage_counts.reclaimable);
 }
 
-// Sort function for qsort
-int compare_paths(const void* a, const void* b) {
+// Sort function for qsort (orders the file table itself by file size, then
+// by inode so that hardlinks end up next to each other)
+int compare_entry_sizes(const void* a, const void* b) {
+    const FileEntry* fileA = a;
+    const FileEntry* fileB = b;
+    if (fileA->size != fileB->size) return (fileA->size > fileB->size) ? 1 : -1;
+    if (fileA->dev != fileB->dev) return (fileA->dev > fileB->dev) ? 1 : -1;
+    return (fileA->ino > fileB->ino) - (fileA->ino < fileB->ino);
+}
+
+// Sort function for qsort (orders entry pointers by inode)
+static int compare_inodes(const void* a, const void* b) {
     FileEntry* fileA = *(FileEntry**)a;
     FileEntry* fileB = *(FileEntry**)b;
-    return strcmp(fileA->path, fileB->path);
+    if (fileA->dev != fileB->dev) return (fileA->dev > fileB->dev) ? 1 : -1;
+    return (fileA->ino > fileB->ino) - (fileA->ino < fileB->ino);
 }
 
-// Finds duplicates and prints results
-void find_duplicates() {
-    int total_files = 0;
-    for (FileEntry* temp = file_list; temp != NULL; temp = temp->next) {
-        total_files++;
+// Number of distinct inodes among `count` members (reorders them)
+static int count_inodes(FileEntry** members, int count) {
+    qsort(members, count, sizeof(FileEntry*), compare_inodes);
+    int inodes = 1;
+    for (int i = 1; i < count; i++) {
+        if (compare_inodes(&members[i - 1], &members[i]) != 0) inodes++;
     }
+    return inodes;
+}
 
-    for (FileEntry* current = file_list; current != NULL; current = current->next) {
-        if (current->processed) continue; // Skip already processed entries
+// Sort function for qsort (orders entry pointers by file size)
+int compare_sizes(const void* a, const void* b) {
+    FileEntry* fileA = *(FileEntry**)a;
+    FileEntry* fileB = *(FileEntry**)b;
+    return (fileA->size > fileB->size) - (fileA->size < fileB->size);
+}
 
-        int count = 0;
-        FileEntry** duplicates = malloc(sizeof(FileEntry*) * total_files); // Scales dynamically
-        if (!duplicates) {
-            fprintf(stderr, "Memory allocation failed for duplicate tracking\n");
-            return;
-        }
+// Sort function for qsort (orders entries by size, then head/tail hash)
+int compare_partials(const void* a, const void* b) {
+    FileEntry* fileA = *(FileEntry**)a;
+    FileEntry* fileB = *(FileEntry**)b;
+    int by_size = compare_sizes(a, b);
+    return by_size ? by_size : memcmp(fileA->hash, fileB->hash, DIGEST_LEN);
+}
 
-        FileEntry* compare = file_list;
-        while (compare != NULL) {
-            if (!compare->processed && strcmp(current->hash, compare->hash) == 0) {
-                duplicates[count] = compare;
-                count++;
-                compare->processed = 1; //Mark as processed
-            }
-            compare = compare->next;
-        }
+// Sort function for qsort (orders entries by full digest, then size, so
+// a digest collision between files of different sizes never joins them;
+// xxh64 fills only 8 of the DIGEST_LEN bytes)
+int compare_digests(const void* a, const void* b) {
+    FileEntry* fileA = *(FileEntry**)a;
+    FileEntry* fileB = *(FileEntry**)b;
+    int by_digest = memcmp(fileA->hash, fileB->hash, DIGEST_LEN);
+    return by_digest ? by_digest : compare_sizes(a, b);
+}
 
-        // Sort duplicate paths before printing
-        qsort(duplicates, count, sizeof(FileEntry*), compare_paths);
+// Sort function for qsort (paths are rebuilt from the arena to compare)
+int compare_paths(const void* a, const void* b) {
+    char pathA[PATH_MAX], pathB[PATH_MAX];
+    entry_path(*(FileEntry**)a, pathA, sizeof(pathA));
+    entry_path(*(FileEntry**)b, pathB, sizeof(pathB));
+    return strcmp(pathA, pathB);
+}
 
-        // Print duplicates only if count > 1
-        if (count > 1) {
-            for (int i = 0; i < count; i++) {
-                printf("%d %d %s\n", count, i + 1, duplicates[i]->path);
-            }
+// Sort function for qsort (orders groups by their first path)
+static int compare_groups(const void* a, const void* b) {
+    const DupGroup* groupA = a;
+    const DupGroup* groupB = b;
+    return compare_paths(groupA->members, groupB->members);
+}
+
+int split_duplicates(FileEntry** members, int count, int* class_len, DupGroup* groups) {
+    int nclasses = 1;
+    class_len[0] = count;
+    if (verify && count > 1 && !members[0]->compared) { // Classes are already byte-identical
+        nclasses = lockstep_partition(members, count, class_len);
+        stage_counts.verify_split += nclasses - 1;
+    }
+
+    // Keep duplicates only if count > 1, with paths sorted for printing
+    int ngroups = 0;
+    for (int c = 0; c < nclasses; c++) {
+        int inodes = class_len[c] > 1 ? count_inodes(members, class_len[c]) : 1;
+        if (inodes > 1) {
+            stage_counts.dup_groups++;
+            stage_counts.dup_copies += inodes - 1;
+            stage_counts.reclaimable += (unsigned long long)(inodes - 1) * members[0]->size;
+            qsort(members, class_len[c], sizeof(FileEntry*), compare_paths);
+            groups[ngroups].members = members;
+            groups[ngroups].count = class_len[c];
+            ngroups++;
         }
+        members += class_len[c];
+    }
+    return ngroups;
+}
 
-        free(duplicates);
+void print_group(const DupGroup* group) {
+    char path[PATH_MAX];
+    for (int i = 0; i < group->count; i++) {
+        entry_path(group->members[i], path, sizeof(path));
+        printf("%d %d %s\n", group->count, i + 1, path);
     }
 }
 
-// Frees the file list to prevent memory leaks
-void free_file_list() {
-    FileEntry* temp;
-    while (file_list != NULL) {
-        temp = file_list;
-        file_list = file_list->next;
-        free(temp);
+// Finds duplicates and prints results. Candidates are sorted by raw digest
+// and size so identical files become adjacent runs: O(n log n) overall instead of
+// comparing every entry against every other one. With --verify each run is
+// then byte-compared, so a digest collision can only split a group, never
+// report files that differ. A group whose names all lead to one inode is
+// already hardlinked and wastes nothing, so it is not reported. With
+// --reclaim the printed groups are then handed to reclaim_groups().
+void find_duplicates() {
+    int total_files = 0;
+    for (size_t i = 0; i < file_table.count; i++) {
+        if (!file_table.entries[i].processed) total_files++;
+    }
+    if (total_files == 0) return;
+    phase_begin(PHASE_GROUP);
+
+    FileEntry** candidates = malloc(sizeof(FileEntry*) * total_files);
+    DupGroup* groups = malloc(sizeof(DupGroup) * (total_files / 2));
+    int* class_len = malloc(sizeof(int) * total_files);
+    if (!candidates || !class_len || (total_files > 1 && !groups)) {
+        fprintf(stderr, "Memory allocation failed for duplicate tracking\n");
+        exit(EXIT_FAILURE);
+    }
+    int n = 0;
+    for (size_t i = 0; i < file_table.count; i++) {
+        if (!file_table.entries[i].processed) {
+            candidates[n++] = &file_table.entries[i]; // Skip non-candidates
+        }
     }
+    qsort(candidates, n, sizeof(FileEntry*), compare_digests);
+
+    int ngroups = 0;
+    int start = 0;
+    while (start < n) {
+        int end = start + 1;
+        while (end < n && compare_digests(&candidates[start], &candidates[end]) == 0) end++;
+        ngroups += split_duplicates(candidates + start, end - start, class_len, groups + ngroups);
+        start = end;
+    }
+
+    // Print groups in path order so output does not depend on scan order
+    qsort(groups, ngroups, sizeof(DupGroup), compare_groups);
+    for (int g = 0; g < ngroups; g++) print_group(&groups[g]);
+    fflush(stdout);
+    phase_end(PHASE_GROUP);
+    if (reclaim_mode != RECLAIM_NONE) {
+        phase_begin(PHASE_RECLAIM);
+        reclaim_groups(groups, ngroups, nthreads);
+        phase_end(PHASE_RECLAIM);
+    }
+
+    free(candidates);
+    free(groups);
+    free(class_len);
 }
 
+// Frees the file table and names to prevent memory leaks
+void free_file_table() {
+    table_free(&file_table);
+    arena_free(&name_arena);
+}
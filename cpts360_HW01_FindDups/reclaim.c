@@ -0,0 +1,350 @@
+//
+//  reclaim.c
+//  PA01_FindDups
+//
+//  Turns reported duplicates into shared storage. The first member of a
+//  group (in path order) is kept. Both the kept copy and every name of
+//  another inode must still have the device, inode, size and mtime the
+//  scan saw; a file written to since then is left alone.
+//
+//  Reflinks use FIDEDUPERANGE, which has the kernel compare the two files
+//  and share their extents in one step, so bytes that changed after any
+//  check of ours are never replaced. The file keeps its own inode, mode,
+//  owner and times. Hardlinks are compared byte for byte first; the link
+//  to the kept copy is made under a temporary name in the same directory,
+//  both files are checked against the scan once more, and the link is
+//  renamed over the duplicate. A hardlink shares the kept copy's metadata.
+//  Anything that fails leaves the original name untouched.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h> // for PATH_MAX
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/fs.h> // FIDEDUPERANGE
+#endif
+
+#include "reclaim.h"
+#include "stats.h"
+
+#define VERIFY_CHUNK (1024 * 1024)
+#define DEDUPE_CHUNK (16 * 1024 * 1024) // The most btrfs shares per FIDEDUPERANGE
+#define TEMP_PREFIX ".finddups."
+
+ReclaimMode reclaim_mode = RECLAIM_NONE;
+ReclaimStats reclaim_stats;
+
+static atomic_uint temp_seq; // Suffix for hardlink temporary names
+
+typedef struct {
+    const DupGroup* groups;
+    int ngroups;
+    atomic_int next;      // Next group to claim
+    pthread_mutex_t lock; // Guards reclaim_stats
+} Reclaimer;
+
+// Per-thread comparison buffers
+typedef struct {
+    unsigned char* a;
+    unsigned char* b;
+} VerifyBufs;
+
+ReclaimMode reclaim_lookup(const char* name) {
+    if (strcmp(name, "reflink") == 0) return RECLAIM_REFLINK;
+    if (strcmp(name, "hardlink") == 0) return RECLAIM_HARDLINK;
+    return RECLAIM_NONE;
+}
+
+// Fills buf as far as possible from `offset`, so short reads cannot look
+// like a difference
+static ssize_t pread_full(int fd, unsigned char* buf, size_t size, off_t offset) {
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = pread(fd, buf + got, size - got, offset + got);
+        count_read(n);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        got += n;
+    }
+    return got;
+}
+
+// 1 if both descriptors hold the same `size` bytes, 0 if not, -1 on error
+static int same_bytes(int fdA, int fdB, uint64_t size, VerifyBufs* bufs) {
+    for (uint64_t off = 0; off < size; off += VERIFY_CHUNK) {
+        size_t want = size - off < VERIFY_CHUNK ? size - off : VERIFY_CHUNK;
+        ssize_t na = pread_full(fdA, bufs->a, want, (off_t)off);
+        ssize_t nb = pread_full(fdB, bufs->b, want, (off_t)off);
+        if (na < 0 || nb < 0) return -1;
+        if (na != (ssize_t)want || nb != (ssize_t)want) return 0; // Shrank since the scan
+        if (memcmp(bufs->a, bufs->b, want) != 0) return 0;
+    }
+    return 1;
+}
+
+// Writes "<dir of path>/.finddups.<suffix>" into buf
+static int temp_name(const char* path, const char* suffix, char* buf, size_t len) {
+    const char* slash = strrchr(path, '/');
+    int dirlen = slash ? (int)(slash - path) + 1 : 0;
+    int n = snprintf(buf, len, "%.*s" TEMP_PREFIX "%s", dirlen, path, suffix);
+    return n < 0 || (size_t)n >= len ? -1 : 0;
+}
+
+// The file is still the one the scan saw: same inode, size and mtime
+static int matches_scan(const struct stat* sb, const FileEntry* entry) {
+    int64_t mtime_ns = (int64_t)sb->st_mtim.tv_sec * 1000000000 + sb->st_mtim.tv_nsec;
+    return pack_dev(sb->st_dev) == entry->dev && sb->st_ino == entry->ino &&
+           (uint64_t)sb->st_size == entry->size && mtime_ns == entry_mtime(entry);
+}
+
+static int unchanged(const char* path, const FileEntry* entry) {
+    struct stat now;
+    return lstat(path, &now) == 0 && matches_scan(&now, entry);
+}
+
+// Shares the extents of `keep_fd` with `fd`, `size` bytes from the start,
+// where the kernel finds them identical. Returns 1 once all of them are
+// shared, 0 if the contents differ, -1 with errno set on error.
+static int dedupe_into(int keep_fd, int fd, uint64_t size) {
+#ifdef FIDEDUPERANGE
+    struct file_dedupe_range* range =
+        malloc(sizeof(struct file_dedupe_range) + sizeof(struct file_dedupe_range_info));
+    if (!range) {
+        fprintf(stderr, "Memory allocation failed for reclaim\n");
+        exit(EXIT_FAILURE);
+    }
+    int status = 1;
+    for (uint64_t off = 0; off < size && status == 1;) {
+        memset(range, 0, sizeof(*range) + sizeof(range->info[0]));
+        range->src_offset = off;
+        range->src_length = size - off < DEDUPE_CHUNK ? size - off : DEDUPE_CHUNK;
+        range->dest_count = 1;
+        range->info[0].dest_fd = fd;
+        range->info[0].dest_offset = off;
+        if (ioctl(keep_fd, FIDEDUPERANGE, range) != 0) {
+            status = -1;
+        } else if (range->info[0].status == FILE_DEDUPE_RANGE_DIFFERS) {
+            status = 0;
+        } else if (range->info[0].status < 0) {
+            errno = -range->info[0].status;
+            status = -1;
+        } else if (range->info[0].bytes_deduped == 0) {
+            errno = EIO; // No progress; do not loop forever
+            status = -1;
+        } else {
+            off += range->info[0].bytes_deduped;
+        }
+    }
+    free(range);
+    return status;
+#else
+    (void)keep_fd;
+    (void)fd;
+    (void)size;
+    errno = EOPNOTSUPP;
+    return -1;
+#endif
+}
+
+// Links the kept copy under a new name next to `path` and renames it over,
+// provided neither file has changed since the scan
+static int replace_hardlink(const FileEntry* keep, const char* keep_path, const FileEntry* entry,
+                            const char* path) {
+    char temp[PATH_MAX + 32];
+    for (;;) {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "%d.%u", (int)getpid(), atomic_fetch_add(&temp_seq, 1));
+        if (temp_name(path, suffix, temp, sizeof(temp)) != 0) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        if (link(keep_path, temp) == 0) break;
+        if (errno != EEXIST) return -1;
+    }
+
+    if (!unchanged(temp, keep) || !unchanged(path, entry)) {
+        unlink(temp);
+        errno = ESTALE;
+        return -1;
+    }
+    if (rename(temp, path) != 0) {
+        int saved = errno;
+        unlink(temp);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+// Sort function for qsort (orders entry pointers by inode, keeping the
+// group's path order among names of one inode)
+static int compare_inodes(const void* a, const void* b) {
+    const FileEntry* fileA = *(FileEntry* const*)a;
+    const FileEntry* fileB = *(FileEntry* const*)b;
+    if (fileA->dev != fileB->dev) return (fileA->dev > fileB->dev) ? 1 : -1;
+    if (fileA->ino != fileB->ino) return (fileA->ino > fileB->ino) ? 1 : -1;
+    return (fileA > fileB) - (fileA < fileB);
+}
+
+// Replaces one name; returns 0 once it shares the kept copy's data
+static int reclaim_name(const FileEntry* keep, int keep_fd, const char* keep_path,
+                        const FileEntry* entry, VerifyBufs* bufs) {
+    char path[PATH_MAX];
+    if (entry_path(entry, path, sizeof(path)) != 0) {
+        fprintf(stderr, "Path too long: %s\n", entry->name);
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY | O_NOFOLLOW);
+    if (fd >= 0) count_open();
+    struct stat sb;
+    if (fd < 0 || fstat(fd, &sb) != 0) {
+        fprintf(stderr, "Cannot open file %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    int status = -1;
+    int same = 0;
+    if (!matches_scan(&sb, entry)) {
+        fprintf(stderr, "Not reclaiming %s: changed since the scan\n", path);
+    } else if ((same = reclaim_mode == RECLAIM_REFLINK ? dedupe_into(keep_fd, fd, entry->size)
+                                                       : same_bytes(keep_fd, fd, entry->size, bufs)) < 0) {
+        fprintf(stderr, "Cannot reclaim %s: %s\n", path, strerror(errno));
+    } else if (!same) {
+        fprintf(stderr, "Not reclaiming %s: contents differ from %s\n", path, keep_path);
+    } else if (reclaim_mode == RECLAIM_HARDLINK &&
+               replace_hardlink(keep, keep_path, entry, path) != 0) {
+        fprintf(stderr, "Cannot reclaim %s: %s\n", path, strerror(errno));
+    } else {
+        status = 0;
+    }
+    close(fd);
+    return status;
+}
+
+static void reclaim_group(const DupGroup* group, VerifyBufs* bufs, ReclaimStats* stats) {
+    const FileEntry* keep = group->members[0];
+    char keep_path[PATH_MAX];
+    int keep_fd = -1;
+    struct stat keep_sb;
+    if (entry_path(keep, keep_path, sizeof(keep_path)) == 0) {
+        keep_fd = open(keep_path, O_RDONLY | O_NOFOLLOW);
+        if (keep_fd >= 0) count_open();
+    }
+    int keep_changed = 0;
+    if (keep_fd >= 0 && (fstat(keep_fd, &keep_sb) != 0 || !matches_scan(&keep_sb, keep))) {
+        close(keep_fd);
+        keep_fd = -1;
+        keep_changed = 1;
+    }
+
+    FileEntry** by_inode = malloc(sizeof(FileEntry*) * group->count);
+    if (!by_inode) {
+        fprintf(stderr, "Memory allocation failed for reclaim\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(by_inode, group->members, sizeof(FileEntry*) * group->count);
+    qsort(by_inode, group->count, sizeof(FileEntry*), compare_inodes);
+
+    if (keep_changed) {
+        fprintf(stderr, "Not reclaiming duplicates of %s: changed since the scan\n", keep_path);
+    } else if (keep_fd < 0) {
+        fprintf(stderr, "Cannot open file %s: %s\n", keep_path, strerror(errno));
+    }
+    int start = 0;
+    while (start < group->count) {
+        int end = start + 1;
+        while (end < group->count && by_inode[end]->dev == by_inode[start]->dev &&
+               by_inode[end]->ino == by_inode[start]->ino) end++;
+
+        if (by_inode[start]->dev != keep->dev || by_inode[start]->ino != keep->ino) {
+            int replaced = 0;
+            for (int i = start; i < end; i++) {
+                if (keep_fd >= 0 && reclaim_name(keep, keep_fd, keep_path, by_inode[i], bufs) == 0) {
+                    replaced++;
+                } else {
+                    stats->failed++;
+                }
+            }
+            stats->replaced += replaced;
+            if (replaced == end - start) stats->bytes += by_inode[start]->size;
+        }
+        start = end;
+    }
+
+    if (keep_fd >= 0) close(keep_fd);
+    free(by_inode);
+}
+
+static void* reclaim_worker(void* arg) {
+    Reclaimer* r = arg;
+    VerifyBufs bufs = { malloc(VERIFY_CHUNK), malloc(VERIFY_CHUNK) };
+    if (!bufs.a || !bufs.b) {
+        fprintf(stderr, "Memory allocation failed for reclaim\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ReclaimStats stats = { 0, 0, 0 };
+    int g;
+    while ((g = atomic_fetch_add(&r->next, 1)) < r->ngroups) {
+        reclaim_group(&r->groups[g], &bufs, &stats);
+    }
+
+    pthread_mutex_lock(&r->lock);
+    reclaim_stats.replaced += stats.replaced;
+    reclaim_stats.failed += stats.failed;
+    reclaim_stats.bytes += stats.bytes;
+    pthread_mutex_unlock(&r->lock);
+
+    free(bufs.a);
+    free(bufs.b);
+    return NULL;
+}
+
+void reclaim_groups(const DupGroup* groups, int ngroups, int nthreads) {
+    if (ngroups == 0) return;
+
+    Reclaimer r;
+    r.groups = groups;
+    r.ngroups = ngroups;
+    atomic_init(&r.next, 0);
+    pthread_mutex_init(&r.lock, NULL);
+
+    int n = nthreads < ngroups ? nthreads : ngroups;
+    if (n <= 1) {
+        reclaim_worker(&r);
+    } else {
+        pthread_t* tids = malloc(sizeof(pthread_t) * n);
+        if (!tids) {
+            fprintf(stderr, "Memory allocation failed for reclaim threads\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < n; i++) {
+            if (pthread_create(&tids[i], NULL, reclaim_worker, &r) != 0) {
+                fprintf(stderr, "Cannot start reclaim thread\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (int i = 0; i < n; i++) pthread_join(tids[i], NULL);
+        free(tids);
+    }
+    pthread_mutex_destroy(&r.lock);
+}
+
+void print_reclaim_stats(void) {
+    fprintf(stderr, "reclaimed:                %llu bytes (%ld names replaced by %ss, %ld skipped)\n",
+            reclaim_stats.bytes, reclaim_stats.replaced,
+            reclaim_mode == RECLAIM_REFLINK ? "reflink" : "hardlink", reclaim_stats.failed);
+}
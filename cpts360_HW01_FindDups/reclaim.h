@@ -0,0 +1,36 @@
+//
+//  reclaim.h
+//  PA01_FindDups
+//
+//  Reclaim mode (--reclaim): replaces the members of each duplicate group
+//  with reflinks or hardlinks to one kept copy.
+//
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include "finddups.h"
+
+typedef enum { RECLAIM_NONE, RECLAIM_REFLINK, RECLAIM_HARDLINK } ReclaimMode;
+
+// Space recovered so far, summed over every reclaim_groups() call
+typedef struct {
+    long replaced;              // Names now sharing the kept copy's data
+    long failed;                // Names left alone (changed, differ, or error)
+    unsigned long long bytes;   // Data of the inodes that were replaced
+} ReclaimStats;
+
+extern ReclaimMode reclaim_mode;
+extern ReclaimStats reclaim_stats;
+
+// Parses "reflink" or "hardlink"; RECLAIM_NONE if neither
+ReclaimMode reclaim_lookup(const char* name);
+
+// Keeps the first member of every group and makes each name of the other
+// inodes share the kept copy's data: in place with FIDEDUPERANGE, or by
+// renaming a hardlink over it once its bytes are verified. Files changed
+// since the scan are skipped. Groups are handled on `nthreads` threads.
+void reclaim_groups(const DupGroup* groups, int ngroups, int nthreads);
+
+void print_reclaim_stats(void);
+
+#endif // RECLAIM_H
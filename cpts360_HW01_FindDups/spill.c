@@ -0,0 +1,642 @@
+//
+//  spill.c
+//  PA01_FindDups
+//
+//  External-memory version of the candidate pipeline. Every scanned path is
+//  appended once to a path file, and from then on a file is only a
+//  fixed-size record holding its size, inode, digest and the offset of its
+//  path. Each stage streams records into an external sort: full buffers are
+//  sorted and written to disk as runs, and the next stage reads them back
+//  through a k-way merge, so equal keys arrive next to each other without
+//  ever holding the whole table.
+//
+//      walk -> by size/inode -> head/tail or full hash -> by size/partial
+//           -> full hash -> by digest -> print groups
+//
+//  A group is passed on only once a second inode with the same key shows
+//  up, so unique files are dropped while streaming, exactly as the
+//  in-memory pipeline drops them. Spill files are unlinked as soon as they
+//  are created and vanish when the program exits.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "spill.h"
+#include "hashpool.h"
+#include "reclaim.h"
+#include "stats.h"
+#include "walk.h"
+
+#define MAX_FANIN 64                  // Runs merged at once; more take extra passes
+#define MIN_READ_BUFFER (64 * 1024)   // stdio buffer per run while merging
+#define NAME_ESTIMATE 64              // Path bytes assumed per file when sizing batches
+
+enum { REC_UNHASHED, REC_PARTIAL, REC_FULL };
+
+// One file as stored in the runs (80 bytes)
+typedef struct {
+    uint64_t size;
+    uint64_t dev, ino;
+    int64_t mtime_ns;  // As scanned, so --reclaim can tell if the file changed
+    uint64_t path_off; // Start of the NUL-terminated path in the path file
+    unsigned char hash[DIGEST_LEN];
+    uint32_t state;    // REC_*: what `hash` holds
+    uint32_t pad;
+} SpillRecord;
+
+typedef int (*RecordCmp)(const void* a, const void* b);
+
+// A k-way merge over sorted runs, with a binary heap of run indices
+typedef struct {
+    FILE** files;
+    char** bufs;
+    SpillRecord* heads; // Smallest unread record of each run
+    int* heap;
+    int nheap;
+    RecordCmp cmp;
+} Merge;
+
+// External sort. Records collect in `buf`; a full buffer is sorted and
+// written out as a run. If nothing was ever written, reading just walks
+// the sorted buffer.
+typedef struct {
+    const char* dir;
+    RecordCmp cmp;
+    SpillRecord* buf;   // Allocated on first use
+    size_t count, capacity, next;
+    size_t read_budget; // stdio buffering shared by the runs while merging
+    int* runs;          // File descriptors of the runs
+    int nruns, runs_cap;
+    Merge merge;
+    int merging;
+} Sorter;
+
+// Entries being hashed for one stage, flushed into `out` when full
+typedef struct {
+    FileEntry* entries; // Fixed capacity, so queued jobs keep valid pointers
+    SpillRecord* recs;  // Record each entry came from
+    size_t count, capacity;
+    Arena names;        // Paths of the entries
+    HashPool* pool;
+    Sorter* out;
+} HashBatch;
+
+typedef struct {
+    const char* dir;
+    FILE* paths;          // Every scanned path, NUL-terminated
+    uint64_t paths_len;
+    pthread_mutex_t lock; // Serializes walker flushes
+    Sorter by_size, by_partial, by_digest;
+    HashBatch batch;
+    SpillRecord last;     // Previous record seen by the size stage
+    int have_last;
+} Spill;
+
+typedef void (*RecordFn)(Spill* sp, const SpillRecord* rec, int keep);
+
+static int cmp_u64(uint64_t a, uint64_t b) {
+    return (a > b) - (a < b);
+}
+
+static int same_inode(const SpillRecord* a, const SpillRecord* b) {
+    return a->dev == b->dev && a->ino == b->ino;
+}
+
+// Groups of the size stage: equal size
+static int group_size(const void* a, const void* b) {
+    return cmp_u64(((const SpillRecord*)a)->size, ((const SpillRecord*)b)->size);
+}
+
+// Groups of the partial stage: equal size, and equal head/tail or full hash
+static int group_partial(const void* a, const void* b) {
+    const SpillRecord* recA = a;
+    const SpillRecord* recB = b;
+    int c = cmp_u64(recA->size, recB->size);
+    if (c == 0) c = cmp_u64(recA->state, recB->state);
+    return c ? c : memcmp(recA->hash, recB->hash, DIGEST_LEN);
+}
+
+// Groups of the report: equal full digest
+static int group_digest(const void* a, const void* b) {
+    const SpillRecord* recA = a;
+    const SpillRecord* recB = b;
+    int c = memcmp(recA->hash, recB->hash, DIGEST_LEN);
+    return c ? c : cmp_u64(recA->size, recB->size);
+}
+
+// Within a group, names of one inode are adjacent and in scan order
+static int cmp_inode(const SpillRecord* a, const SpillRecord* b) {
+    int c = cmp_u64(a->dev, b->dev);
+    if (c == 0) c = cmp_u64(a->ino, b->ino);
+    return c ? c : cmp_u64(a->path_off, b->path_off);
+}
+
+static int cmp_by_size(const void* a, const void* b) {
+    int c = group_size(a, b);
+    return c ? c : cmp_inode(a, b);
+}
+
+static int cmp_by_partial(const void* a, const void* b) {
+    int c = group_partial(a, b);
+    return c ? c : cmp_inode(a, b);
+}
+
+static int cmp_by_digest(const void* a, const void* b) {
+    int c = group_digest(a, b);
+    return c ? c : cmp_inode(a, b);
+}
+
+// Creates an anonymous read/write file in the spill directory
+static FILE* spill_file(const char* dir) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/finddups.XXXXXX", dir);
+    int fd = mkstemp(path);
+    FILE* file = fd < 0 ? NULL : fdopen(fd, "w+b");
+    if (!file) {
+        fprintf(stderr, "Cannot create spill file in %s: %s\n", dir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    unlink(path);
+    return file;
+}
+
+static void write_records(FILE* file, const SpillRecord* recs, size_t count) {
+    if (fwrite(recs, sizeof(SpillRecord), count, file) != count) {
+        fprintf(stderr, "Cannot write spill file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Flushes `file` and keeps only a descriptor for it
+static int close_run(FILE* file) {
+    int fd = fflush(file) == 0 ? dup(fileno(file)) : -1;
+    if (fd < 0) {
+        fprintf(stderr, "Cannot write spill file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    fclose(file);
+    return fd;
+}
+
+static void add_run(Sorter* s, int fd) {
+    if (s->nruns == s->runs_cap) {
+        s->runs_cap = s->runs_cap ? s->runs_cap * 2 : 16;
+        s->runs = realloc(s->runs, sizeof(int) * s->runs_cap);
+        if (!s->runs) {
+            fprintf(stderr, "Memory allocation failed for spill runs\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    s->runs[s->nruns++] = fd;
+}
+
+static void merge_sift_down(Merge* m, int i) {
+    for (;;) {
+        int least = i, l = 2 * i + 1, r = l + 1;
+        if (l < m->nheap && m->cmp(&m->heads[m->heap[l]], &m->heads[m->heap[least]]) < 0) least = l;
+        if (r < m->nheap && m->cmp(&m->heads[m->heap[r]], &m->heads[m->heap[least]]) < 0) least = r;
+        if (least == i) return;
+        int tmp = m->heap[i];
+        m->heap[i] = m->heap[least];
+        m->heap[least] = tmp;
+        i = least;
+    }
+}
+
+// Starts merging `k` runs; each descriptor is owned (and closed) by the merge
+static void merge_open(Merge* m, const int* fds, int k, RecordCmp cmp, size_t budget) {
+    size_t bufsize = budget / k < MIN_READ_BUFFER ? MIN_READ_BUFFER : budget / k;
+    m->files = calloc(k, sizeof(FILE*));
+    m->bufs = calloc(k, sizeof(char*));
+    m->heads = calloc(k, sizeof(SpillRecord));
+    m->heap = calloc(k, sizeof(int));
+    if (!m->files || !m->bufs || !m->heads || !m->heap) {
+        fprintf(stderr, "Memory allocation failed for spill merge\n");
+        exit(EXIT_FAILURE);
+    }
+    m->nheap = 0;
+    m->cmp = cmp;
+
+    for (int i = 0; i < k; i++) {
+        m->bufs[i] = malloc(bufsize);
+        if (lseek(fds[i], 0, SEEK_SET) != 0 || !m->bufs[i] || !(m->files[i] = fdopen(fds[i], "rb"))) {
+            fprintf(stderr, "Cannot read spill file: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        setvbuf(m->files[i], m->bufs[i], _IOFBF, bufsize);
+        if (fread(&m->heads[i], sizeof(SpillRecord), 1, m->files[i]) == 1) {
+            m->heap[m->nheap++] = i;
+        }
+    }
+    for (int i = m->nheap / 2 - 1; i >= 0; i--) merge_sift_down(m, i);
+}
+
+static int merge_next(Merge* m, SpillRecord* rec) {
+    if (m->nheap == 0) return 0;
+
+    int run = m->heap[0];
+    *rec = m->heads[run];
+    if (fread(&m->heads[run], sizeof(SpillRecord), 1, m->files[run]) != 1) {
+        m->heap[0] = m->heap[--m->nheap]; // Run exhausted
+    }
+    merge_sift_down(m, 0);
+    return 1;
+}
+
+static void merge_close(Merge* m, int k) {
+    for (int i = 0; i < k; i++) {
+        if (m->files[i]) fclose(m->files[i]);
+        free(m->bufs[i]);
+    }
+    free(m->files);
+    free(m->bufs);
+    free(m->heads);
+    free(m->heap);
+}
+
+static void sorter_init(Sorter* s, const char* dir, RecordCmp cmp, size_t bytes, size_t read_budget) {
+    memset(s, 0, sizeof(*s));
+    s->dir = dir;
+    s->cmp = cmp;
+    s->capacity = bytes / sizeof(SpillRecord) < 1024 ? 1024 : bytes / sizeof(SpillRecord);
+    s->read_budget = read_budget;
+}
+
+// Sorts the buffer and writes it out as a new run
+static void write_run(Sorter* s) {
+    qsort(s->buf, s->count, sizeof(SpillRecord), s->cmp);
+    FILE* file = spill_file(s->dir);
+    write_records(file, s->buf, s->count);
+    add_run(s, close_run(file));
+    s->count = 0;
+}
+
+static void sorter_add(Sorter* s, const SpillRecord* rec) {
+    if (!s->buf) {
+        s->buf = malloc(sizeof(SpillRecord) * s->capacity);
+        if (!s->buf) {
+            fprintf(stderr, "Memory allocation failed for spill buffer\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (s->count == s->capacity) write_run(s);
+    s->buf[s->count++] = *rec;
+}
+
+// Ends the input and prepares to read the records back in order
+static void sorter_finish(Sorter* s) {
+    if (s->nruns == 0) {
+        if (s->count) qsort(s->buf, s->count, sizeof(SpillRecord), s->cmp);
+        s->next = 0;
+        return;
+    }
+
+    if (s->count) write_run(s);
+    free(s->buf);
+    s->buf = NULL;
+
+    // Too many runs to buffer at once: merge them in batches into longer runs
+    while (s->nruns > MAX_FANIN) {
+        Merge m;
+        merge_open(&m, s->runs, MAX_FANIN, s->cmp, s->read_budget);
+        FILE* file = spill_file(s->dir);
+        SpillRecord rec;
+        while (merge_next(&m, &rec)) write_records(file, &rec, 1);
+        merge_close(&m, MAX_FANIN);
+        memmove(s->runs, s->runs + MAX_FANIN, sizeof(int) * (s->nruns - MAX_FANIN));
+        s->nruns -= MAX_FANIN;
+        add_run(s, close_run(file));
+    }
+    merge_open(&s->merge, s->runs, s->nruns, s->cmp, s->read_budget);
+    s->merging = 1;
+}
+
+static int sorter_next(Sorter* s, SpillRecord* rec) {
+    if (s->merging) return merge_next(&s->merge, rec);
+    if (s->next == s->count) return 0;
+    *rec = s->buf[s->next++];
+    return 1;
+}
+
+static void sorter_free(Sorter* s) {
+    if (s->merging) merge_close(&s->merge, s->nruns);
+    free(s->buf);
+    free(s->runs);
+    memset(s, 0, sizeof(*s));
+}
+
+// Walker sink: appends each path to the path file and its record to the
+// size sort
+static void spill_files(const FileTable* batch, void* arg) {
+    Spill* sp = arg;
+    char path[PATH_MAX];
+
+    pthread_mutex_lock(&sp->lock);
+    for (size_t i = 0; i < batch->count; i++) {
+        const FileEntry* entry = &batch->entries[i];
+        if (entry_path(entry, path, sizeof(path)) != 0) {
+            fprintf(stderr, "Path too long: %s\n", entry->name);
+            continue;
+        }
+        size_t len = strlen(path) + 1;
+        if (fwrite(path, 1, len, sp->paths) != len) {
+            fprintf(stderr, "Cannot write spill file: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        SpillRecord rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.size = entry->size;
+        rec.dev = entry->dev;
+        rec.ino = entry->ino;
+        rec.mtime_ns = entry_mtime(entry);
+        rec.path_off = sp->paths_len;
+        rec.state = REC_UNHASHED;
+        sorter_add(&sp->by_size, &rec);
+        sp->paths_len += len;
+        stage_counts.files++;
+    }
+    pthread_mutex_unlock(&sp->lock);
+}
+
+// Reads a record's path back from the path file
+static void read_path(Spill* sp, const SpillRecord* rec, char* buf) {
+    ssize_t n = pread(fileno(sp->paths), buf, PATH_MAX, (off_t)rec->path_off);
+    buf[n > 0 ? n : 0] = '\0';
+    buf[PATH_MAX - 1] = '\0';
+}
+
+static void batch_init(HashBatch* b, size_t bytes, HashPool* pool) {
+    b->capacity = bytes / (sizeof(FileEntry) + sizeof(SpillRecord) + NAME_ESTIMATE);
+    if (b->capacity < 256) b->capacity = 256;
+    b->entries = malloc(sizeof(FileEntry) * b->capacity);
+    b->recs = malloc(sizeof(SpillRecord) * b->capacity);
+    if (!b->entries || !b->recs) {
+        fprintf(stderr, "Memory allocation failed for hash batch\n");
+        exit(EXIT_FAILURE);
+    }
+    b->count = 0;
+    arena_init(&b->names);
+    b->pool = pool;
+}
+
+// Waits for the batch and passes every readable file on to b->out. A name
+// for the same inode as the entry before it was not hashed and copies
+// that entry's result.
+static void batch_drain(HashBatch* b) {
+    hashpool_wait(b->pool);
+    for (size_t i = 0; i < b->count; i++) {
+        FileEntry* entry = &b->entries[i];
+        if (entry->link) {
+            memcpy(entry->hash, entry[-1].hash, DIGEST_LEN);
+            entry->processed = entry[-1].processed;
+        } else if (entry->processed) {
+            stage_counts.unreadable++;
+        } else if (b->recs[i].state == REC_PARTIAL) {
+            stage_counts.partial_hashed++;
+        } else {
+            stage_counts.full_hashed++;
+        }
+
+        if (!entry->processed) {
+            memcpy(b->recs[i].hash, entry->hash, DIGEST_LEN);
+            sorter_add(b->out, &b->recs[i]);
+        }
+    }
+    b->count = 0;
+    arena_free(&b->names);
+}
+
+// Queues a record for hashing; its result replaces rec->hash
+static void batch_add(Spill* sp, const SpillRecord* rec, HashKind kind) {
+    HashBatch* b = &sp->batch;
+    if (b->count == b->capacity) batch_drain(b);
+
+    SpillRecord* r = &b->recs[b->count];
+    FileEntry* entry = &b->entries[b->count];
+    *r = *rec;
+    r->state = kind == HASH_PARTIAL ? REC_PARTIAL : REC_FULL;
+    memset(entry, 0, sizeof(*entry));
+    entry->size = rec->size;
+    entry->dev = (uint32_t)rec->dev;
+    entry->ino = rec->ino;
+    if (b->count > 0 && same_inode(r, r - 1)) {
+        entry->link = 1;
+        b->count++;
+        return;
+    }
+
+    char path[PATH_MAX + 1];
+    read_path(sp, rec, path);
+    entry->name = arena_strdup(&b->names, path);
+    b->count++;
+    hashpool_submit(b->pool, entry, kind);
+}
+
+// Streams `in` and calls fn(rec, 1) for every record whose group (per
+// `same_group`) holds at least two inodes, and fn(rec, 0) for the rest.
+// Only the names of a group's first inode are held back, until the next
+// inode decides whether the group is kept.
+static void filter_groups(Spill* sp, Sorter* in, RecordCmp same_group, RecordFn fn) {
+    SpillRecord* pending = NULL;
+    size_t npending = 0, cap = 0;
+    int confirmed = 0;
+    SpillRecord rec;
+
+    while (sorter_next(in, &rec)) {
+        if (npending && same_group(&rec, &pending[0]) == 0) {
+            if (confirmed) {
+                fn(sp, &rec, 1);
+                continue;
+            }
+            if (!same_inode(&rec, &pending[0])) {
+                for (size_t i = 0; i < npending; i++) fn(sp, &pending[i], 1);
+                pending[0] = rec; // Keep the group key
+                npending = 1;
+                confirmed = 1;
+                fn(sp, &rec, 1);
+                continue;
+            }
+        } else {
+            for (size_t i = 0; !confirmed && i < npending; i++) fn(sp, &pending[i], 0);
+            npending = 0;
+            confirmed = 0;
+        }
+
+        if (npending == cap) {
+            cap = cap ? cap * 2 : 16;
+            pending = realloc(pending, sizeof(SpillRecord) * cap);
+            if (!pending) {
+                fprintf(stderr, "Memory allocation failed for spill group\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        pending[npending++] = rec;
+    }
+    for (size_t i = 0; !confirmed && i < npending; i++) fn(sp, &pending[i], 0);
+    free(pending);
+}
+
+// Size stage: same-size files get a head/tail hash if they are large
+// enough, otherwise a full one
+static void size_stage(Spill* sp, const SpillRecord* rec, int keep) {
+    if (sp->have_last && same_inode(rec, &sp->last)) stage_counts.links++;
+    sp->last = *rec;
+    sp->have_last = 1;
+
+    if (!keep) {
+        stage_counts.size_unique++;
+    } else if (partial_block > 0 && rec->size > 2 * partial_block) {
+        batch_add(sp, rec, HASH_PARTIAL);
+    } else {
+        batch_add(sp, rec, HASH_FULL);
+    }
+}
+
+// Partial stage: files whose head and tail match another inode are hashed
+// in full; files that already have a full digest go straight through
+static void partial_stage(Spill* sp, const SpillRecord* rec, int keep) {
+    if (rec->state == REC_FULL) {
+        if (keep) sorter_add(&sp->by_digest, rec);
+    } else if (!keep) {
+        stage_counts.partial_unique++;
+    } else {
+        batch_add(sp, rec, HASH_FULL);
+    }
+}
+
+// Prints the duplicates among `count` records with one digest
+static void report_group(Spill* sp, const SpillRecord* recs, int count) {
+    FileEntry* entries = calloc(count, sizeof(FileEntry));
+    FileEntry** members = malloc(sizeof(FileEntry*) * count);
+    int* class_len = malloc(sizeof(int) * count);
+    DupGroup* groups = malloc(sizeof(DupGroup) * (count / 2));
+    if (!entries || !members || !class_len || !groups) {
+        fprintf(stderr, "Memory allocation failed for duplicate tracking\n");
+        exit(EXIT_FAILURE);
+    }
+
+    Arena names;
+    arena_init(&names);
+    char path[PATH_MAX + 1];
+    for (int i = 0; i < count; i++) {
+        read_path(sp, &recs[i], path);
+        entries[i].name = arena_filename(&names, path, recs[i].mtime_ns);
+        entries[i].size = recs[i].size;
+        entries[i].dev = (uint32_t)recs[i].dev;
+        entries[i].ino = recs[i].ino;
+        memcpy(entries[i].hash, recs[i].hash, DIGEST_LEN);
+        entries[i].hashed = 1;
+        members[i] = &entries[i];
+    }
+
+    int ngroups = split_duplicates(members, count, class_len, groups);
+    for (int g = 0; g < ngroups; g++) print_group(&groups[g]);
+    if (reclaim_mode != RECLAIM_NONE && ngroups > 0) {
+        phase_end(PHASE_GROUP);
+        phase_begin(PHASE_RECLAIM);
+        reclaim_groups(groups, ngroups, nthreads);
+        phase_end(PHASE_RECLAIM);
+        phase_begin(PHASE_GROUP);
+    }
+
+    arena_free(&names);
+    free(entries);
+    free(members);
+    free(class_len);
+    free(groups);
+}
+
+// Collects each run of equal digests and reports it
+static void report_duplicates(Spill* sp) {
+    SpillRecord* group = NULL;
+    int count = 0, cap = 0;
+    SpillRecord rec;
+
+    while (sorter_next(&sp->by_digest, &rec)) {
+        if (count && group_digest(&rec, &group[0]) != 0) {
+            if (count > 1) report_group(sp, group, count);
+            count = 0;
+        }
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            group = realloc(group, sizeof(SpillRecord) * cap);
+            if (!group) {
+                fprintf(stderr, "Memory allocation failed for spill group\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        group[count++] = rec;
+    }
+    if (count > 1) report_group(sp, group, count);
+    free(group);
+}
+
+void spill_find_duplicates(char* const* roots, int nroots, const FileTable* named,
+                           const char* dir, size_t mem_limit, WalkStats* stats) {
+    // Live at once: two sort buffers, one hash batch and the merge buffers
+    size_t quarter = mem_limit / 4, eighth = mem_limit / 8;
+
+    Spill sp;
+    memset(&sp, 0, sizeof(sp));
+    sp.dir = dir;
+    sp.paths = spill_file(dir);
+    pthread_mutex_init(&sp.lock, NULL);
+    sorter_init(&sp.by_size, dir, cmp_by_size, quarter, eighth);
+    sorter_init(&sp.by_partial, dir, cmp_by_partial, quarter, eighth);
+    sorter_init(&sp.by_digest, dir, cmp_by_digest, quarter, eighth);
+
+    // Stage 1: every file, sorted by size. Directory nodes are only needed
+    // until each path has been written out.
+    FileTable unused = { NULL, 0, 0 };
+    Arena dirs;
+    arena_init(&dirs);
+    size_t per_thread = eighth / nthreads / (sizeof(FileEntry) + NAME_ESTIMATE);
+    walk_sink.flush = spill_files;
+    walk_sink.arg = &sp;
+    walk_sink.batch = per_thread < 256 ? 256 : per_thread;
+    phase_begin(PHASE_SCAN);
+    spill_files(named, &sp);
+    walk_directories(roots, nroots, nthreads, &unused, &dirs, stats);
+    walk_sink.flush = NULL;
+    arena_free(&dirs);
+    if (fflush(sp.paths) != 0) {
+        fprintf(stderr, "Cannot write spill file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    sorter_finish(&sp.by_size);
+    phase_end(PHASE_SCAN);
+
+    // Stage 2: hash same-size candidates, then sort by size and hash
+    phase_begin(PHASE_HASH);
+    batch_init(&sp.batch, eighth, hashpool_create(nthreads));
+    sp.batch.out = &sp.by_partial;
+    filter_groups(&sp, &sp.by_size, group_size, size_stage);
+    batch_drain(&sp.batch);
+    sorter_free(&sp.by_size);
+    sorter_finish(&sp.by_partial);
+
+    // Stage 3: full hash of head/tail matches, then sort by digest
+    sp.batch.out = &sp.by_digest;
+    filter_groups(&sp, &sp.by_partial, group_partial, partial_stage);
+    batch_drain(&sp.batch);
+    sorter_free(&sp.by_partial);
+    sorter_finish(&sp.by_digest);
+    phase_end(PHASE_HASH);
+
+    phase_begin(PHASE_GROUP);
+    report_duplicates(&sp);
+    sorter_free(&sp.by_digest);
+    phase_end(PHASE_GROUP);
+
+    hashpool_destroy(sp.batch.pool);
+    free(sp.batch.entries);
+    free(sp.batch.recs);
+    fclose(sp.paths);
+    pthread_mutex_destroy(&sp.lock);
+}
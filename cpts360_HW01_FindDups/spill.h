@@ -0,0 +1,24 @@
+//
+//  spill.h
+//  PA01_FindDups
+//
+//  External-memory mode (--spill-dir) for trees whose file table does not
+//  fit in RAM. Files become fixed-size records in sorted runs on disk that
+//  are merged k-way between the pipeline stages.
+//
+#ifndef SPILL_H
+#define SPILL_H
+
+#include "finddups.h"
+#include "walk.h"
+
+// Scans `roots` plus the files already in `named` (those given on the
+// command line), runs the size, head/tail and full-hash stages through
+// sorted runs in `dir`, and prints every duplicate group. Memory use stays
+// near `mem_limit` bytes apart from the directory nodes and the members of
+// the group being printed. Groups come out in digest order, each one
+// sorted by path. The walk's syscall counts go to `stats`.
+void spill_find_duplicates(char* const* roots, int nroots, const FileTable* named,
+                           const char* dir, size_t mem_limit, WalkStats* stats);
+
+#endif // SPILL_H
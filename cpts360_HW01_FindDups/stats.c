@@ -0,0 +1,167 @@
+//
+//  stats.c
+//  PA01_FindDups
+//
+//  Wall time comes from CLOCK_MONOTONIC and CPU time from
+//  CLOCK_PROCESS_CPUTIME_ID, so a phase's CPU time covers every thread and
+//  can exceed its wall time when the pool or the walker run in parallel.
+//  The progress thread only reads the live counters; it never takes a lock
+//  that the workers use.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "stats.h"
+#include "finddups.h"
+
+RunCounters run_counters;
+
+typedef struct {
+    long long wall_ns, cpu_ns;     // Accumulated
+    long long wall_start, cpu_start;
+    int active;
+} PhaseTimer;
+
+static const char* const phase_names[PHASE_COUNT] = { "scan", "hash", "group", "reclaim" };
+static PhaseTimer phases[PHASE_COUNT];
+static volatile int current_phase = PHASE_SCAN; // Shown by the progress line
+
+static struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int seconds;
+    int running;
+    long long start_ns;
+} progress = { .lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER };
+
+static long long clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+long long now_ns(void) {
+    return clock_ns(CLOCK_MONOTONIC);
+}
+
+void phase_begin(Phase phase) {
+    PhaseTimer* t = &phases[phase];
+    if (t->active++) return;
+    t->wall_start = now_ns();
+    t->cpu_start = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+    current_phase = phase;
+}
+
+void phase_end(Phase phase) {
+    PhaseTimer* t = &phases[phase];
+    if (--t->active) return;
+    t->wall_ns += now_ns() - t->wall_start;
+    t->cpu_ns += clock_ns(CLOCK_PROCESS_CPUTIME_ID) - t->cpu_start;
+}
+
+static double seconds(long long ns) {
+    return ns / 1e9;
+}
+
+static void print_progress(void) {
+    double elapsed = seconds(now_ns() - progress.start_ns);
+    unsigned long long bytes = atomic_load(&run_counters.bytes_read);
+    fprintf(stderr, "[%7.0fs] %-7s %ld dirs, %ld files | %ld opened, %.1f MiB read (%.1f MiB/s)\n",
+            elapsed, phase_names[current_phase], atomic_load(&run_counters.dirs),
+            atomic_load(&run_counters.files), atomic_load(&run_counters.opens),
+            bytes / 1048576.0, elapsed > 0 ? bytes / 1048576.0 / elapsed : 0.0);
+}
+
+static void* progress_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&progress.lock);
+    long long next = progress.start_ns;
+    while (progress.running) {
+        next += (long long)progress.seconds * 1000000000;
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        long long wait = next - now_ns();
+        if (wait > 0) {
+            deadline.tv_sec += wait / 1000000000;
+            deadline.tv_nsec += wait % 1000000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&progress.wake, &progress.lock, &deadline);
+        }
+        if (progress.running && now_ns() >= next) print_progress();
+    }
+    pthread_mutex_unlock(&progress.lock);
+    return NULL;
+}
+
+void progress_start(int interval) {
+    progress.seconds = interval;
+    progress.running = 1;
+    progress.start_ns = now_ns();
+    if (pthread_create(&progress.thread, NULL, progress_thread, NULL) != 0) {
+        fprintf(stderr, "Cannot start progress thread\n");
+        progress.running = 0;
+    }
+}
+
+void progress_stop(void) {
+    pthread_mutex_lock(&progress.lock);
+    int was_running = progress.running;
+    progress.running = 0;
+    pthread_cond_signal(&progress.wake);
+    pthread_mutex_unlock(&progress.lock);
+    if (was_running) pthread_join(progress.thread, NULL);
+}
+
+void print_phase_stats(const WalkStats* walk) {
+    long long wall = 0, cpu = 0;
+    fprintf(stderr, "phase      wall s     cpu s\n");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        fprintf(stderr, "%-8s %8.3f  %8.3f\n", phase_names[p], seconds(phases[p].wall_ns),
+                seconds(phases[p].cpu_ns));
+        wall += phases[p].wall_ns;
+        cpu += phases[p].cpu_ns;
+    }
+    fprintf(stderr, "%-8s %8.3f  %8.3f\n", "total", seconds(wall), seconds(cpu));
+
+    unsigned long long bytes = atomic_load(&run_counters.bytes_read);
+    long long busy = phases[PHASE_HASH].wall_ns + phases[PHASE_GROUP].wall_ns;
+    fprintf(stderr, "files opened:             %ld\n", atomic_load(&run_counters.opens));
+    fprintf(stderr, "read calls:               %ld\n", atomic_load(&run_counters.reads));
+    fprintf(stderr, "bytes read:               %llu (%.1f MiB/s while hashing and grouping)\n",
+            bytes, busy > 0 ? bytes / 1048576.0 / seconds(busy) : 0.0);
+    fprintf(stderr, "time in hash_file():      %.3f s over all threads\n",
+            seconds(atomic_load(&run_counters.hash_ns)));
+    fprintf(stderr, "metadata syscalls:        %ld (%ld open, %ld getdents64, %ld stat)\n",
+            walk->dirs + walk->getdents + walk->stats, walk->dirs, walk->getdents, walk->stats);
+}
+
+void print_stats_json(const WalkStats* walk) {
+    const StageCounts* s = &stage_counts;
+    fprintf(stderr, "{\n  \"phases\": {");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        fprintf(stderr, "%s\n    \"%s\": { \"wall_s\": %.6f, \"cpu_s\": %.6f }", p ? "," : "",
+                phase_names[p], seconds(phases[p].wall_ns), seconds(phases[p].cpu_ns));
+    }
+    fprintf(stderr, "\n  },\n");
+    fprintf(stderr, "  \"walk\": { \"dirs\": %ld, \"files\": %ld, \"getdents\": %ld, \"stats\": %ld },\n",
+            walk->dirs, walk->files, walk->getdents, walk->stats);
+    fprintf(stderr, "  \"io\": { \"opens\": %ld, \"reads\": %ld, \"bytes_read\": %llu, "
+                    "\"hash_s\": %.6f },\n",
+            atomic_load(&run_counters.opens), atomic_load(&run_counters.reads),
+            (unsigned long long)atomic_load(&run_counters.bytes_read),
+            seconds(atomic_load(&run_counters.hash_ns)));
+    fprintf(stderr, "  \"stages\": { \"files\": %ld, \"size_unique\": %ld, \"cache_hits\": %ld, "
+                    "\"partial_hashed\": %ld, \"partial_unique\": %ld, \"full_hashed\": %ld, "
+                    "\"compared\": %ld, \"compare_unique\": %ld, \"unreadable\": %ld, "
+                    "\"verify_split\": %ld, \"links\": %ld, \"dup_groups\": %ld, "
+                    "\"dup_copies\": %ld, \"reclaimable\": %llu }\n}\n",
+            s->files, s->size_unique, s->cache_hits, s->partial_hashed, s->partial_unique,
+            s->full_hashed, s->compared, s->compare_unique, s->unreadable, s->verify_split,
+            s->links, s->dup_groups, s->dup_copies, s->reclaimable);
+}
@@ -0,0 +1,55 @@
+//
+//  stats.h
+//  PA01_FindDups
+//
+//  Phase timers, live I/O counters and the --stats / --progress reports.
+//
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+
+#include "walk.h"
+
+typedef enum { PHASE_SCAN, PHASE_HASH, PHASE_GROUP, PHASE_RECLAIM, PHASE_COUNT } Phase;
+
+// Bumped while work happens, from any thread, so --progress can read them
+typedef struct {
+    atomic_long dirs;          // Directories read by the walker
+    atomic_long files;         // Regular files found by the walker
+    atomic_long opens;         // Files opened to hash, compare or reclaim
+    atomic_long reads;         // read()/pread() calls; a mapped file counts once
+    atomic_ullong bytes_read;  // File data read by those calls
+    atomic_llong hash_ns;      // Time inside hash_file()/partial_hash_file(), all threads
+} RunCounters;
+
+extern RunCounters run_counters;
+
+static inline void count_read(long long nbytes) {
+    atomic_fetch_add_explicit(&run_counters.reads, 1, memory_order_relaxed);
+    if (nbytes > 0) {
+        atomic_fetch_add_explicit(&run_counters.bytes_read, nbytes, memory_order_relaxed);
+    }
+}
+
+static inline void count_open(void) {
+    atomic_fetch_add_explicit(&run_counters.opens, 1, memory_order_relaxed);
+}
+
+// Monotonic clock in nanoseconds
+long long now_ns(void);
+
+// Phases may nest or repeat; each one accumulates wall and process CPU time
+void phase_begin(Phase phase);
+void phase_end(Phase phase);
+
+// Prints a progress line on stderr every `seconds` until progress_stop()
+void progress_start(int seconds);
+void progress_stop(void);
+
+// Phase times and I/O counters as text, or everything (including the
+// stage counts) as one JSON object; both go to stderr
+void print_phase_stats(const WalkStats* walk);
+void print_stats_json(const WalkStats* walk);
+
+#endif // STATS_H
@@ -0,0 +1,120 @@
+//
+//  failread.c
+//  PA01_FindDups
+//
+//  LD_PRELOAD shim for the tests: read() on a file whose path contains
+//  FAILREAD_MATCH succeeds for the first FAILREAD_AFTER bytes (default 0)
+//  and then fails with EIO. pread() is left alone, so hashing still works
+//  and only the byte-compare stages see the failures.
+//
+//  Files opened with O_NOFOLLOW (and not O_DIRECTORY) are the ones
+//  --reclaim is about to replace or keep. Just before such an open, a file
+//  whose path contains FAILREAD_APPEND gets one byte appended, and one
+//  whose path contains FAILREAD_TOUCH gets its mtime moved a second ahead,
+//  as if they were written to after the scan.
+//
+//  With FAILREAD_NO_INO set, statx() leaves STATX_INO out of the fields it
+//  reports, as some filesystems do.
+//
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MAX_FDS 4096
+
+static long long remaining[MAX_FDS]; // Bytes left before failing, +1; 0 = not tracked
+
+static int matches(const char* path, const char* var) {
+    const char* match = getenv(var);
+    return match && *match && strstr(path, match);
+}
+
+static void track(int fd, const char* path) {
+    if (fd < 0 || fd >= MAX_FDS) return;
+    remaining[fd] = 0;
+    if (matches(path, "FAILREAD_MATCH")) {
+        const char* after = getenv("FAILREAD_AFTER");
+        remaining[fd] = (after ? atoll(after) : 0) + 1;
+    }
+}
+
+// Changes a file the way FAILREAD_APPEND or FAILREAD_TOUCH asks
+static void modify(int (*next)(const char*, int, ...), const char* path) {
+    if (matches(path, "FAILREAD_APPEND")) {
+        int fd = next(path, O_WRONLY | O_APPEND, 0);
+        if (fd >= 0) {
+            ssize_t (*next_write)(int, const void*, size_t) =
+                (ssize_t (*)(int, const void*, size_t))dlsym(RTLD_NEXT, "write");
+            if (next_write(fd, "x", 1) != 1) abort();
+            close(fd);
+        }
+    }
+    if (matches(path, "FAILREAD_TOUCH")) {
+        struct stat sb;
+        if (stat(path, &sb) == 0) {
+            struct timespec times[2] = { sb.st_atim, sb.st_mtim };
+            times[1].tv_sec++;
+            utimensat(AT_FDCWD, path, times, 0);
+        }
+    }
+}
+
+static int real_open(const char* name, const char* path, int flags, mode_t mode) {
+    int (*next)(const char*, int, ...) = (int (*)(const char*, int, ...))dlsym(RTLD_NEXT, name);
+    if ((flags & O_NOFOLLOW) && !(flags & O_DIRECTORY)) modify(next, path);
+    int fd = next(path, flags, mode);
+    track(fd, path);
+    return fd;
+}
+
+int open(const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, int);
+        va_end(ap);
+    }
+    return real_open("open", path, flags, mode);
+}
+
+int open64(const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, int);
+        va_end(ap);
+    }
+    return real_open("open64", path, flags, mode);
+}
+
+int statx(int dirfd, const char* path, int flags, unsigned int mask, struct statx* stx) {
+    static int (*next)(int, const char*, int, unsigned int, struct statx*);
+    if (!next) next = (int (*)(int, const char*, int, unsigned int, struct statx*))dlsym(RTLD_NEXT, "statx");
+    int rc = next(dirfd, path, flags, mask, stx);
+    if (rc == 0 && getenv("FAILREAD_NO_INO")) stx->stx_mask &= ~STATX_INO;
+    return rc;
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+    static ssize_t (*next)(int, void*, size_t);
+    if (!next) next = (ssize_t (*)(int, void*, size_t))dlsym(RTLD_NEXT, "read");
+    if (fd >= 0 && fd < MAX_FDS && remaining[fd] > 0) {
+        if (remaining[fd] == 1) {
+            errno = EIO;
+            return -1;
+        }
+        if ((long long)count > remaining[fd] - 1) count = remaining[fd] - 1;
+        ssize_t n = next(fd, buf, count);
+        if (n > 0) remaining[fd] -= n;
+        return n;
+    }
+    return next(fd, buf, count);
+}
@@ -0,0 +1,222 @@
+#!/bin/bash
+#
+#  run_tests.sh
+#  PA01_FindDups
+#
+#  Regression tests run against an AddressSanitizer build (make test).
+#  Read failures are injected with tests/failread.so: read() on any file
+#  whose name contains _FAIL fails with EIO after FAILREAD_AFTER bytes.
+#  The same shim changes files between the scan and --reclaim.
+#  A test passes when finddups exits cleanly, without a sanitizer report,
+#  and prints the expected groups.
+#
+#  usage: tests/run_tests.sh [finddups-binary] [failread.so]
+#
+
+FINDDUPS=${1:-./finddups_asan}
+FAILREAD=${2:-./tests/failread.so}
+WORK=$(mktemp -d /tmp/finddups_tests.XXXXXX) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+
+# The shim is not built with ASan, so it may come before the runtime
+export ASAN_OPTIONS=verify_asan_link_order=0:detect_leaks=0
+failed=0
+
+# run NAME EXPECTED-STDOUT FAILREAD_AFTER finddups-args...
+run() {
+    local name=$1 expected=$2 after=$3
+    shift 3
+    local out err status
+    out=$(LD_PRELOAD=$FAILREAD FAILREAD_MATCH=_FAIL FAILREAD_AFTER=$after \
+          "$FINDDUPS" "$@" 2> "$WORK/stderr")
+    status=$?
+    if [ $status -ne 0 ] || grep -q "Sanitizer" "$WORK/stderr" || [ "$out" != "$expected" ]; then
+        echo "FAIL: $name (exit $status)"
+        echo "--- expected"; echo "$expected"
+        echo "--- got"; echo "$out"
+        sed 's/^/    /' "$WORK/stderr" | head -20
+        failed=1
+    else
+        echo "ok: $name"
+    fi
+}
+
+# Two pairs that agree in their head and tail blocks but differ inside the
+# first 128 KiB chunk, so the lockstep stage splits them in its first
+# round. Three of the files then fail in the second round.
+mkdir "$WORK/split"
+head -c 300000 /dev/urandom > "$WORK/split/a"
+cp "$WORK/split/a" "$WORK/split/b_FAIL"
+cp "$WORK/split/a" "$WORK/split/c_FAIL"
+printf 'X' | dd of="$WORK/split/c_FAIL" bs=1 seek=65536 conv=notrunc 2> /dev/null
+cp "$WORK/split/c_FAIL" "$WORK/split/d_FAIL"
+run "lockstep: read failures after a split" "" 131072 "$WORK/split"
+
+# The same files, with one of the second group failing: the survivors
+# are still compared to the end
+mkdir "$WORK/partial"
+cp "$WORK/split/a" "$WORK/partial/a"
+cp "$WORK/split/a" "$WORK/partial/b"
+cp "$WORK/split/c_FAIL" "$WORK/partial/c_FAIL"
+cp "$WORK/split/c_FAIL" "$WORK/partial/d"
+cp "$WORK/split/c_FAIL" "$WORK/partial/e"
+run "lockstep: survivors still grouped" "2 1 $WORK/partial/a
+2 2 $WORK/partial/b
+2 1 $WORK/partial/d
+2 2 $WORK/partial/e" 131072 --lockstep=8 "$WORK/partial"
+
+# --verify byte-compares each hashed group with the same code as the
+# lockstep stage. Hashing uses pread(), which the shim lets through, so
+# the groups reach the verify pass whole and the files fail there.
+mkdir "$WORK/verify"
+cp "$WORK/split/a" "$WORK/verify/a"
+cp "$WORK/split/a" "$WORK/verify/b"
+cp "$WORK/split/a" "$WORK/verify/c_FAIL"
+cp "$WORK/split/c_FAIL" "$WORK/verify/d_FAIL"
+cp "$WORK/split/c_FAIL" "$WORK/verify/e_FAIL"
+cp "$WORK/split/c_FAIL" "$WORK/verify/f_FAIL"
+run "verify: read failures part way through" "2 1 $WORK/verify/a
+2 2 $WORK/verify/b" 131072 --verify --lockstep=0 "$WORK/verify"
+run "verify: read failures at the first byte" "2 1 $WORK/verify/a
+2 2 $WORK/verify/b" 0 --verify --lockstep=0 "$WORK/verify"
+
+# Symbolic links below the root are skipped, whether the walker trusts
+# d_type or stats every entry; a symlinked root is followed
+mkdir -p "$WORK/links/sub"
+head -c 5000 /dev/urandom > "$WORK/links/f"
+cp "$WORK/links/f" "$WORK/links/g"
+cp "$WORK/links/f" "$WORK/links/sub/h"
+ln -s f "$WORK/links/file_link"
+ln -s sub "$WORK/links/dir_link"
+ln -s .. "$WORK/links/sub/loop"
+ln -s links "$WORK/root_link"
+expected="3 1 $WORK/links/f
+3 2 $WORK/links/g
+3 3 $WORK/links/sub/h"
+run "walk: symlinks skipped" "$expected" 0 "$WORK/links"
+run "walk: symlinks skipped with --stat-all" "$expected" 0 --stat-all "$WORK/links"
+run "walk: symlinked root followed" "${expected//$WORK\/links/$WORK/root_link}" 0 "$WORK/root_link"
+FAILREAD_NO_INO=1 run "walk: statx() without STATX_INO" "$expected" 0 "$WORK/links"
+
+# A cache whose record count is off by 2^58 still matches the file size
+# once the count is multiplied by the 64-byte record size in 64 bits. It
+# must be ignored, not searched.
+"$FINDDUPS" --cache="$WORK/cache" "$WORK/links" > /dev/null 2>&1
+printf '\004' | dd of="$WORK/cache" bs=1 seek=31 conv=notrunc 2> /dev/null
+run "cache: record count past the end of the file" "$expected" 0 --cache="$WORK/cache" "$WORK/links"
+grep -q "Ignoring corrupt cache" "$WORK/stderr" \
+    || { echo "FAIL: cache: corrupt count not reported"; failed=1; }
+
+# Files of different sizes whose digests collide are never grouped. The
+# collision is forged in the digest cache: the 2000-byte pair's records
+# get the 1000-byte pair's digest.
+mkdir "$WORK/collide"
+head -c 1000 /dev/urandom > "$WORK/collide/a1"
+cp "$WORK/collide/a1" "$WORK/collide/a2"
+head -c 2000 /dev/urandom > "$WORK/collide/b1"
+cp "$WORK/collide/b1" "$WORK/collide/b2"
+"$FINDDUPS" --cache="$WORK/collide.cache" "$WORK/collide" > /dev/null 2>&1
+python3 -c 'import struct, sys
+data = bytearray(open(sys.argv[1], "rb").read())
+recs = range(32, len(data), 64)  # 32-byte header, then dev, ino, size, mtime, digest
+small = next(r for r in recs if struct.unpack_from("<Q", data, r + 16)[0] == 1000)
+for r in recs:
+    if struct.unpack_from("<Q", data, r + 16)[0] == 2000:
+        data[r + 32:r + 64] = data[small + 32:small + 64]
+open(sys.argv[1], "wb").write(data)' "$WORK/collide.cache"
+run "group: colliding digests of different sizes" "2 1 $WORK/collide/a1
+2 2 $WORK/collide/a2
+2 1 $WORK/collide/b1
+2 2 $WORK/collide/b2" 0 --cache="$WORK/collide.cache" "$WORK/collide"
+
+# reclaim_case NAME MODE SHIM-SETTING LINKED KEPT [OPTION]: --reclaim on a
+# fresh a_keep, b_dup, c_dup trio with the shim changing a file after the
+# scan. The LINKED names must end up as a_keep's inode, the KEPT ones as
+# their own, and no file may lose a byte it had.
+reclaim_case() {
+    local name=$1 mode=$2 setting=$3 linked=$4 kept=$5 option=${6:-}
+    local dir="$WORK/reclaim" ok=1 status
+    rm -rf "$dir"
+    mkdir "$dir"
+    head -c 200000 /dev/urandom > "$WORK/orig"
+    for f in a_keep b_dup c_dup; do cp "$WORK/orig" "$dir/$f"; done
+    env LD_PRELOAD="$FAILREAD" "$setting" "$FINDDUPS" --reclaim="$mode" $option "$dir" \
+        > /dev/null 2> "$WORK/stderr"
+    status=$?
+    [ $status -eq 0 ] && ! grep -q "Sanitizer" "$WORK/stderr" || ok=0
+    local keep_ino=$(stat -c %i "$dir/a_keep")
+    for f in $linked; do [ "$(stat -c %i "$dir/$f")" = "$keep_ino" ] || ok=0; done
+    for f in $kept; do [ "$(stat -c %i "$dir/$f")" != "$keep_ino" ] || ok=0; done
+    for f in a_keep b_dup c_dup; do
+        cmp -s -n 200000 "$WORK/orig" "$dir/$f" || ok=0
+    done
+    if [ $ok -eq 1 ]; then
+        echo "ok: $name"
+    else
+        echo "FAIL: $name (exit $status)"
+        ls -li "$dir" | sed 's/^/    /'
+        sed 's/^/    /' "$WORK/stderr" | head -20
+        failed=1
+    fi
+}
+
+# Hardlinks are checked for changes on both sides right before the rename
+reclaim_case "reclaim: hardlinks made" hardlink FAILREAD_APPEND= "b_dup c_dup" ""
+reclaim_case "reclaim: kept copy appended to" hardlink FAILREAD_APPEND=a_keep "" "b_dup c_dup"
+reclaim_case "reclaim: duplicate appended to" hardlink FAILREAD_APPEND=b_dup "c_dup" "b_dup"
+reclaim_case "reclaim: kept copy touched" hardlink FAILREAD_TOUCH=a_keep "" "b_dup c_dup"
+reclaim_case "reclaim: duplicate touched" hardlink FAILREAD_TOUCH=c_dup "b_dup" "c_dup"
+# Groups found through --spill-dir carry the scan's mtimes too
+reclaim_case "reclaim: spill-dir, hardlinks made" hardlink FAILREAD_APPEND= "b_dup c_dup" "" \
+    --spill-dir="$WORK"
+reclaim_case "reclaim: spill-dir, duplicate touched" hardlink FAILREAD_TOUCH=c_dup "b_dup" "c_dup" \
+    --spill-dir="$WORK"
+# Reflinks check the scan before the kernel compares and shares extents
+# (which needs btrfs or XFS, so the unchanged case is not run here)
+reclaim_case "reclaim: reflink, kept copy appended to" reflink FAILREAD_APPEND=a_keep "" "b_dup c_dup"
+reclaim_case "reclaim: reflink, duplicate touched" reflink FAILREAD_TOUCH=b_dup "" "b_dup"
+
+# query SOCKET REQUEST: one request to a --watch server
+query() {
+    python3 -c 'import socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+s.sendall((sys.argv[2] + "\n").encode())
+sys.stdout.write(s.makefile().read())' "$1" "$2"
+}
+
+# --watch: a directory moved into the tree only settles the size buckets
+# of its own files. The two large files share a size but were told apart
+# by their head blocks, so they must stay unhashed; the moved-in copy of
+# one of them is the only bucket that needs hashing.
+mkdir -p "$WORK/watch/tree" "$WORK/watch/in/sub"
+head -c 100000 /dev/urandom > "$WORK/watch/tree/x"
+head -c 100000 /dev/urandom > "$WORK/watch/tree/y"
+head -c 123 /dev/urandom > "$WORK/watch/tree/z"
+cp "$WORK/watch/tree/z" "$WORK/watch/in/sub/z2"
+head -c 77 /dev/urandom > "$WORK/watch/in/sub/u"
+"$FINDDUPS" --watch="$WORK/watch.sock" "$WORK/watch/tree" > /dev/null 2> "$WORK/stderr" &
+pid=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    [ -S "$WORK/watch.sock" ] && break
+    sleep 0.5
+done
+mv "$WORK/watch/in" "$WORK/watch/tree/in"
+sleep 1
+hashed=$(query "$WORK/watch.sock" stats | awk '/files hashed/ { print $3 }')
+groups=$(query "$WORK/watch.sock" groups)
+kill $pid
+wait $pid
+if grep -q "Sanitizer" "$WORK/stderr" || [ "$hashed" != 2 ] \
+   || [ "$groups" != "2 1 $WORK/watch/tree/in/sub/z2
+2 2 $WORK/watch/tree/z" ]; then
+    echo "FAIL: watch: moved-in directory settles only its own buckets"
+    echo "--- files hashed: $hashed (expected 2)"
+    echo "$groups"
+    sed 's/^/    /' "$WORK/stderr" | head -20
+    failed=1
+else
+    echo "ok: watch: moved-in directory settles only its own buckets"
+fi
+
+exit $failed
@@ -0,0 +1,468 @@
+//
+//  walk.c
+//  PA01_FindDups
+//
+//  Work-stealing directory walker. Every directory is a task. Each thread
+//  owns a deque of tasks: it pushes the subdirectories it discovers and
+//  pops them back LIFO (depth first, so recently read inodes are still
+//  cached), while idle threads steal the oldest task from another thread's
+//  deque, which tends to be the root of a large unexplored subtree. A
+//  thread that finds nothing to steal sleeps on a condition variable until
+//  a task is pushed or the walk ends.
+//
+//  Entries are classified by the d_type the directory read already
+//  returned: subdirectories are queued without any stat at all, and only
+//  regular files get a statx() asking for the few fields the table keeps.
+//  Filesystems that report DT_UNKNOWN fall back to fstatat(). On Linux
+//  directories are read with getdents64() into a large per-thread buffer
+//  rather than readdir()'s small one. Each thread interns names into its
+//  own arena and appends to its own table, so the hot path takes no shared
+//  locks.
+//
+//  A subdirectory is opened with openat() relative to its parent's
+//  descriptor, which its task carries, so the kernel resolves one name
+//  instead of the whole path again, and O_NOFOLLOW keeps a directory
+//  swapped for a symlink mid-walk from leading elsewhere. A parent's
+//  descriptor stays open until all of its subdirectories have been
+//  opened; past HELD_DIRS_MAX held at once, tasks fall back to the full
+//  path.
+//
+//  Symbolic links below the roots are skipped, as --watch skips them. A
+//  link to a file has its target's inode, so it would be taken for a
+//  hardlink of it, and a link to a directory can lead out of the tree or
+//  around in a loop. The roots themselves are followed.
+//
+//  When walk_sink is set (--spill-dir) a thread hands its table over every
+//  walk_sink.batch files instead of keeping it. File names then go to a
+//  separate per-thread arena that is emptied after each hand-over, so only
+//  the directory nodes stay in memory for the whole walk.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
+
+#include "stats.h"
+#include "walk.h"
+
+#define DEQUE_INITIAL 64
+#define HELD_DIRS_MAX 256 // Directory descriptors kept open for openat()
+#define DIRENT_BUFFER_SIZE (128 * 1024) // getdents64() buffer per thread
+
+#ifdef __linux__
+// Record layout filled in by getdents64(); glibc does not declare it
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+int walk_stat_all = 0;
+WalkSink walk_sink = { NULL, NULL, 0 };
+
+// An open directory, shared by the tasks of its subdirectories
+typedef struct {
+    int fd;
+    atomic_int refs; // The scan of the directory itself, plus one per queued task
+} DirHandle;
+
+typedef struct {
+    const DirNode* dir;
+    DirHandle* parent; // NULL: open by full path (roots, or too many held)
+} Task;
+
+typedef struct {
+    Task* tasks; // tasks[top..bottom) are live
+    int top, bottom, capacity;
+    pthread_mutex_t lock;
+} TaskDeque;
+
+typedef struct {
+    int nthreads;
+    TaskDeque* deques;      // One per thread
+    FileTable* files;       // Per-thread tables and arenas, merged at the end
+    Arena* arenas;
+    Arena* names;           // File names while flushing to walk_sink
+    WalkStats* stats;
+    char** dirbufs;         // getdents64() buffers
+    atomic_int held;        // Open DirHandles
+    atomic_long outstanding; // Tasks queued or running; 0 means the walk is done
+    atomic_long queued;      // Tasks in the deques
+    atomic_int sleepers;     // Threads waiting on work_ready
+    pthread_mutex_t idle_lock;
+    pthread_cond_t work_ready; // A task was pushed, or the walk is done
+} Walker;
+
+typedef struct {
+    Walker* walker;
+    int id;
+} WalkerThread;
+
+// Owner side: add a task at the bottom
+static void deque_push(TaskDeque* dq, Task task) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom == dq->capacity) {
+        if (dq->top > 0) {
+            // Reuse the slots freed by thieves before growing
+            memmove(dq->tasks, dq->tasks + dq->top, sizeof(Task) * (dq->bottom - dq->top));
+            dq->bottom -= dq->top;
+            dq->top = 0;
+        } else {
+            dq->capacity *= 2;
+            dq->tasks = realloc(dq->tasks, sizeof(Task) * dq->capacity);
+            if (!dq->tasks) {
+                fprintf(stderr, "Memory allocation failed for directory queue\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    dq->tasks[dq->bottom++] = task;
+    pthread_mutex_unlock(&dq->lock);
+}
+
+// Owner side: take the newest task. Returns 0 if there is none.
+static int deque_pop(TaskDeque* dq, Task* task) {
+    int found = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom > dq->top) {
+        *task = dq->tasks[--dq->bottom];
+        found = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+// Thief side: take the oldest task. Returns 0 if there is none.
+static int deque_steal(TaskDeque* dq, Task* task) {
+    int found = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom > dq->top) {
+        *task = dq->tasks[dq->top++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+// Drops one reference to an open directory, closing it after the last
+static void release_dir(Walker* w, DirHandle* handle) {
+    if (handle && atomic_fetch_sub(&handle->refs, 1) == 1) {
+        close(handle->fd);
+        free(handle);
+        atomic_fetch_sub(&w->held, 1);
+    }
+}
+
+// Wakes one sleeping thread, or all of them for the end of the walk. A
+// sleeper counts itself before its last look at the deques, so it either
+// sees the new task or is counted here.
+static void wake_idle(Walker* w, int all) {
+    if (atomic_load(&w->sleepers) == 0) return;
+    pthread_mutex_lock(&w->idle_lock);
+    if (all) {
+        pthread_cond_broadcast(&w->work_ready);
+    } else {
+        pthread_cond_signal(&w->work_ready);
+    }
+    pthread_mutex_unlock(&w->idle_lock);
+}
+
+static void push_task(Walker* w, int id, const DirNode* dir, DirHandle* parent) {
+    if (parent) atomic_fetch_add(&parent->refs, 1);
+    atomic_fetch_add(&w->outstanding, 1);
+    deque_push(&w->deques[id], (Task){ dir, parent });
+    atomic_fetch_add(&w->queued, 1);
+    wake_idle(w, 0);
+}
+
+// Blocks until a task may be waiting in some deque. Returns 0 once the
+// walk is done.
+static int wait_for_work(Walker* w) {
+    pthread_mutex_lock(&w->idle_lock);
+    atomic_fetch_add(&w->sleepers, 1);
+    while (atomic_load(&w->queued) == 0 && atomic_load(&w->outstanding) > 0) {
+        pthread_cond_wait(&w->work_ready, &w->idle_lock);
+    }
+    atomic_fetch_sub(&w->sleepers, 1);
+    pthread_mutex_unlock(&w->idle_lock);
+    return atomic_load(&w->outstanding) > 0;
+}
+
+// Looks up only type, size, inode and mtime of an entry d_type says is
+// regular; the type is the inode's own, in case the entry was replaced
+// since the directory was read. Returns 0 on success, -1 with errno set
+// otherwise.
+static int stat_regular(Walker* w, int id, int dirfd, const char* name, struct stat* sb) {
+    w->stats[id].stats++;
+#ifdef STATX_BASIC_STATS
+    const unsigned int mask = STATX_TYPE | STATX_SIZE | STATX_INO | STATX_MTIME;
+    struct statx stx;
+    int rc = statx(dirfd, name, AT_SYMLINK_NOFOLLOW, mask, &stx);
+    if (rc == 0 && (stx.stx_mask & mask) == mask) {
+        memset(sb, 0, sizeof(*sb));
+        sb->st_mode = stx.stx_mode;
+        sb->st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+        sb->st_ino = stx.stx_ino;
+        sb->st_size = stx.stx_size;
+        sb->st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+        sb->st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+        return 0;
+    }
+    if (rc != 0 && errno != ENOSYS) return -1;
+    // Kernel without statx(), or a filesystem that left some of the fields
+    // out: ask again the old way
+    w->stats[id].stats++;
+#endif
+    return fstatat(dirfd, name, sb, AT_SYMLINK_NOFOLLOW);
+}
+
+// Hands this thread's files to the sink and starts a new batch
+static void flush_files(Walker* w, int id) {
+    if (w->files[id].count == 0) return;
+    walk_sink.flush(&w->files[id], walk_sink.arg);
+    w->files[id].count = 0;
+    arena_free(&w->names[id]);
+}
+
+// Handles one directory entry: regular files go to this thread's table and
+// subdirectories become new tasks on this thread's deque. Anything else
+// (symlinks, devices, sockets, fifos) is ignored.
+static void add_entry(Walker* w, int id, const DirNode* node, DirHandle* handle, int dirfd,
+                      const char* dir_path, const char* name, unsigned char type) {
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) return;
+
+    struct stat sb;
+    int rc;
+    if (!walk_stat_all && type == DT_DIR) {
+        push_task(w, id, arena_dirnode(&w->arenas[id], node, name), handle);
+        return;
+    } else if (!walk_stat_all && type == DT_REG) {
+        rc = stat_regular(w, id, dirfd, name, &sb);
+    } else if (!walk_stat_all && type != DT_UNKNOWN) {
+        return;
+    } else {
+        w->stats[id].stats++;
+        rc = fstatat(dirfd, name, &sb, AT_SYMLINK_NOFOLLOW);
+    }
+
+    if (rc != 0) {
+        fprintf(stderr, "Error accessing %s/%s: %s\n", dir_path, name, strerror(errno));
+    } else if (S_ISDIR(sb.st_mode)) {
+        push_task(w, id, arena_dirnode(&w->arenas[id], node, name), handle);
+    } else if (S_ISREG(sb.st_mode)) {
+        w->stats[id].files++;
+        Arena* names = walk_sink.flush ? &w->names[id] : &w->arenas[id];
+        int64_t mtime_ns = (int64_t)sb.st_mtim.tv_sec * 1000000000 + sb.st_mtim.tv_nsec;
+        table_add(&w->files[id], node, arena_filename(names, name, mtime_ns), &sb);
+        if (walk_sink.flush && w->files[id].count >= walk_sink.batch) flush_files(w, id);
+    }
+}
+
+// Opens a task's directory: relative to its parent when the parent is
+// still held, by full path otherwise. Only a root may be a symlink.
+static int open_task(Walker* w, Task task, const char* dir_path) {
+    int fd;
+    if (task.parent) {
+        fd = openat(task.parent->fd, task.dir->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+        release_dir(w, task.parent);
+    } else if (task.dir->parent) {
+        fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+    } else {
+        fd = open(dir_path, O_RDONLY | O_DIRECTORY);
+    }
+    return fd;
+}
+
+// Reads one directory and hands each of its entries to add_entry()
+static void scan_directory(Walker* w, int id, Task task) {
+    const DirNode* node = task.dir;
+    char dir_path[PATH_MAX]; // Fix for PATH_MAX error
+    if (dirnode_path(node, dir_path, sizeof(dir_path)) != 0) {
+        fprintf(stderr, "Path too long below %s\n", node->name);
+        release_dir(w, task.parent);
+        return;
+    }
+
+    int fd = open_task(w, task, dir_path);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open directory %s: %s\n", dir_path, strerror(errno));
+        return;
+    }
+    w->stats[id].dirs++;
+
+    // Hold the descriptor for the subdirectories' openat(), if there is room
+    DirHandle* handle = NULL;
+    if (atomic_fetch_add(&w->held, 1) < HELD_DIRS_MAX && (handle = malloc(sizeof(DirHandle)))) {
+        handle->fd = fd;
+        atomic_init(&handle->refs, 1);
+    } else {
+        atomic_fetch_sub(&w->held, 1);
+    }
+    long files_before = w->stats[id].files;
+
+#ifdef __linux__
+    char* buf = w->dirbufs[id];
+    for (;;) {
+        long nread = syscall(SYS_getdents64, fd, buf, DIRENT_BUFFER_SIZE);
+        w->stats[id].getdents++;
+        if (nread < 0) {
+            fprintf(stderr, "Cannot read directory %s: %s\n", dir_path, strerror(errno));
+            break;
+        }
+        if (nread == 0) break;
+
+        for (long off = 0; off < nread;) {
+            struct linux_dirent64* entry = (struct linux_dirent64*)(buf + off);
+            add_entry(w, id, node, handle, fd, dir_path, entry->d_name, entry->d_type);
+            off += entry->d_reclen;
+        }
+    }
+#else
+    // closedir() closes the descriptor it reads, so read a duplicate
+    int dirfd = dup(fd);
+    DIR* dir = dirfd < 0 ? NULL : fdopendir(dirfd);
+    if (!dir) {
+        fprintf(stderr, "Cannot open directory %s: %s\n", dir_path, strerror(errno));
+        if (dirfd >= 0) close(dirfd);
+    } else {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            add_entry(w, id, node, handle, fd, dir_path, entry->d_name, entry->d_type);
+        }
+        closedir(dir);
+    }
+#endif
+    if (handle) {
+        release_dir(w, handle);
+    } else {
+        close(fd);
+    }
+    atomic_fetch_add_explicit(&run_counters.dirs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&run_counters.files, w->stats[id].files - files_before,
+                              memory_order_relaxed);
+}
+
+static void* walker_thread(void* arg) {
+    WalkerThread* self = arg;
+    Walker* w = self->walker;
+    int id = self->id;
+
+    for (;;) {
+        Task task;
+        int found = deque_pop(&w->deques[id], &task);
+        for (int i = 1; !found && i < w->nthreads; i++) {
+            found = deque_steal(&w->deques[(id + i) % w->nthreads], &task);
+        }
+
+        if (found) {
+            atomic_fetch_sub(&w->queued, 1);
+            scan_directory(w, id, task);
+            // Children were counted first, so 0 means no more work anywhere
+            if (atomic_fetch_sub(&w->outstanding, 1) == 1) wake_idle(w, 1);
+        } else if (!wait_for_work(w)) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+void walk_directories(char* const* roots, int nroots, int nthreads,
+                      FileTable* table, Arena* arena, WalkStats* stats) {
+    Walker w;
+    w.nthreads = nthreads < 1 ? 1 : nthreads;
+    w.deques = calloc(w.nthreads, sizeof(TaskDeque));
+    w.files = calloc(w.nthreads, sizeof(FileTable));
+    w.arenas = calloc(w.nthreads, sizeof(Arena));
+    w.names = calloc(w.nthreads, sizeof(Arena));
+    w.stats = calloc(w.nthreads, sizeof(WalkStats));
+    w.dirbufs = calloc(w.nthreads, sizeof(char*));
+    WalkerThread* threads = calloc(w.nthreads, sizeof(WalkerThread));
+    pthread_t* tids = calloc(w.nthreads, sizeof(pthread_t));
+    if (!w.deques || !w.files || !w.arenas || !w.names || !w.stats || !w.dirbufs || !threads || !tids) {
+        fprintf(stderr, "Memory allocation failed for directory walker\n");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&w.outstanding, 0);
+    atomic_init(&w.held, 0);
+    atomic_init(&w.queued, 0);
+    atomic_init(&w.sleepers, 0);
+    pthread_mutex_init(&w.idle_lock, NULL);
+    pthread_cond_init(&w.work_ready, NULL);
+
+    for (int i = 0; i < w.nthreads; i++) {
+        w.deques[i].capacity = DEQUE_INITIAL;
+        w.deques[i].tasks = malloc(sizeof(Task) * DEQUE_INITIAL);
+        w.dirbufs[i] = malloc(DIRENT_BUFFER_SIZE);
+        if (!w.deques[i].tasks || !w.dirbufs[i]) {
+            fprintf(stderr, "Memory allocation failed for directory queue\n");
+            exit(EXIT_FAILURE);
+        }
+        pthread_mutex_init(&w.deques[i].lock, NULL);
+        arena_init(&w.arenas[i]);
+        threads[i].walker = &w;
+        threads[i].id = i;
+    }
+    for (int i = 0; i < nroots; i++) {
+        push_task(&w, i % w.nthreads, arena_dirnode(arena, NULL, roots[i]), NULL);
+    }
+
+    // Thread 0 is the caller, so -j 1 starts no threads at all
+    for (int i = 1; i < w.nthreads; i++) {
+        if (pthread_create(&tids[i], NULL, walker_thread, &threads[i]) != 0) {
+            fprintf(stderr, "Failed to start walker thread %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    walker_thread(&threads[0]);
+    for (int i = 1; i < w.nthreads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    // Hand the per-thread tables and arenas over to the caller
+    if (stats) memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < w.nthreads; i++) {
+        if (walk_sink.flush) {
+            flush_files(&w, i);
+            table_free(&w.files[i]);
+        } else {
+            table_append(table, &w.files[i]);
+        }
+        arena_adopt(arena, &w.arenas[i]);
+        if (stats) {
+            stats->dirs += w.stats[i].dirs;
+            stats->files += w.stats[i].files;
+            stats->getdents += w.stats[i].getdents;
+            stats->stats += w.stats[i].stats;
+        }
+    }
+
+    for (int i = 0; i < w.nthreads; i++) {
+        free(w.deques[i].tasks);
+        free(w.dirbufs[i]);
+        pthread_mutex_destroy(&w.deques[i].lock);
+    }
+    pthread_mutex_destroy(&w.idle_lock);
+    pthread_cond_destroy(&w.work_ready);
+    free(w.deques);
+    free(w.files);
+    free(w.arenas);
+    free(w.names);
+    free(w.stats);
+    free(w.dirbufs);
+    free(threads);
+    free(tids);
+}
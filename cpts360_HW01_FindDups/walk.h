@@ -0,0 +1,43 @@
+//
+//  walk.h
+//  PA01_FindDups
+//
+//  Parallel directory traversal.
+//
+#ifndef WALK_H
+#define WALK_H
+
+#include "finddups.h"
+
+// What one walk found and the metadata system calls it issued
+typedef struct {
+    long dirs;     // Directories opened
+    long files;    // Regular files found
+    long getdents; // getdents64() calls (Linux only)
+    long stats;    // statx()/fstatat() calls
+} WalkStats;
+
+// Classify every entry with fstatat() instead of trusting d_type (--stat-all)
+extern int walk_stat_all;
+
+// Receives a batch of files from one walker thread (--spill-dir). The
+// batch and its names are only valid during the call, and calls from
+// different threads are not serialized.
+typedef struct {
+    void (*flush)(const FileTable* batch, void* arg);
+    void* arg;
+    size_t batch; // Files a thread collects before flushing
+} WalkSink;
+
+// NULL flush (the default) keeps every file in walk_directories()' table
+extern WalkSink walk_sink;
+
+// Scans every directory in `roots` (and everything below them) using
+// `nthreads` threads and appends each regular file found to `table`.
+// Symbolic links below the roots are not followed.
+// Names and directory nodes are allocated from `arena`. If `stats` is not
+// NULL it receives the syscall counts.
+void walk_directories(char* const* roots, int nroots, int nthreads,
+                      FileTable* table, Arena* arena, WalkStats* stats);
+
+#endif // WALK_H
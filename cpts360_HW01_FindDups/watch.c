@@ -0,0 +1,695 @@
+//
+//  watch.c
+//  PA01_FindDups
+//
+//  The live index holds one record per path, linked into three chained
+//  hash tables: by path, by size (a bucket per size) and by size + digest
+//  (a group per distinct content). Only files whose size bucket holds
+//  another inode need a digest, exactly as in the batch pipeline, so a new
+//  file costs a stat and at most the hashing of its own bucket's unhashed
+//  members. Queries walk the groups and never touch the disk.
+//
+//  Events come from inotify, one watch per directory. A full event queue
+//  (IN_Q_OVERFLOW) means changes were lost, so the index is rebuilt from a
+//  fresh scan. A directory moved out of the tree is dropped along with
+//  everything below it; one moved in is scanned like a new one.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h> // for PATH_MAX
+#include <ftw.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "watch.h"
+
+#define WATCH_MASK (IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+#define EVENT_BUFFER_SIZE (64 * 1024)
+#define INDEX_INITIAL 1024
+#define NFTW_FDS 64
+#define QUERY_TIMEOUT_SECONDS 1 // A client that sends nothing is dropped
+
+// Chain link; each record type starts with one so the tables stay generic
+typedef struct Link {
+    struct Link* next;
+    uint64_t hash;
+} Link;
+
+typedef struct {
+    Link** slots;
+    size_t nslots, count;
+} HashIndex;
+
+typedef struct Bucket Bucket;
+typedef struct Group Group;
+
+typedef struct WFile {
+    Link link;                   // In the path index
+    char* path;
+    uint64_t size, dev, ino;
+    int64_t mtime_ns;
+    unsigned char hash[DIGEST_LEN];
+    int hashed;
+    Bucket* bucket;
+    Group* group;                // NULL until hashed
+    struct WFile *prev_size, *next_size; // Bucket members
+    struct WFile *prev_dup, *next_dup;   // Group members
+} WFile;
+
+// Files of one size
+struct Bucket {
+    Link link;
+    uint64_t size;
+    WFile* members;
+    Bucket* next_added;          // Buckets add_tree() has added files to
+    int added;
+};
+
+// Hashed files of one size and digest
+struct Group {
+    Link link;
+    uint64_t size;
+    unsigned char hash[DIGEST_LEN];
+    long count;
+    WFile* members;
+};
+
+static struct {
+    int ifd;               // inotify descriptor
+    char** wd_paths;       // Directory of each watch descriptor
+    int wd_cap;
+    char* const* roots;
+    int nroots;
+    int index_files;       // nftw() callback also indexes files
+    Bucket* added;         // Buckets to settle once the nftw() is done
+    HashIndex by_path, by_size, by_digest;
+    DigestCtx* ctx;
+    long files, events, hashes, rescans;
+} W;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+// ---- generic chained index ----
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    return x ^ (x >> 33);
+}
+
+static uint64_t hash_path(const char* path) {
+    uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a
+    for (; *path; path++) h = (h ^ (unsigned char)*path) * 0x100000001b3ULL;
+    return h;
+}
+
+static uint64_t hash_content(uint64_t size, const unsigned char* digest) {
+    uint64_t h;
+    memcpy(&h, digest, sizeof(h));
+    return mix64(h ^ size);
+}
+
+static void index_init(HashIndex* index) {
+    index->nslots = INDEX_INITIAL;
+    index->count = 0;
+    index->slots = calloc(index->nslots, sizeof(Link*));
+    if (!index->slots) {
+        fprintf(stderr, "Memory allocation failed for watch index\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static Link* index_chain(const HashIndex* index, uint64_t hash) {
+    return index->slots[hash & (index->nslots - 1)];
+}
+
+static void index_insert(HashIndex* index, Link* link) {
+    if (index->count >= index->nslots) {
+        // Load factor 1 reached: double and rehash from the stored hashes
+        size_t nslots = index->nslots * 2;
+        Link** slots = calloc(nslots, sizeof(Link*));
+        if (!slots) {
+            fprintf(stderr, "Memory allocation failed for watch index\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < index->nslots; i++) {
+            for (Link* l = index->slots[i]; l;) {
+                Link* next = l->next;
+                l->next = slots[l->hash & (nslots - 1)];
+                slots[l->hash & (nslots - 1)] = l;
+                l = next;
+            }
+        }
+        free(index->slots);
+        index->slots = slots;
+        index->nslots = nslots;
+    }
+    Link** slot = &index->slots[link->hash & (index->nslots - 1)];
+    link->next = *slot;
+    *slot = link;
+    index->count++;
+}
+
+static void index_remove(HashIndex* index, Link* link) {
+    Link** p = &index->slots[link->hash & (index->nslots - 1)];
+    while (*p != link) p = &(*p)->next;
+    *p = link->next;
+    index->count--;
+}
+
+// ---- records ----
+
+static WFile* file_find(const char* path) {
+    uint64_t h = hash_path(path);
+    for (Link* l = index_chain(&W.by_path, h); l; l = l->next) {
+        WFile* f = (WFile*)l;
+        if (l->hash == h && strcmp(f->path, path) == 0) return f;
+    }
+    return NULL;
+}
+
+static Bucket* bucket_get(uint64_t size) {
+    uint64_t h = mix64(size);
+    for (Link* l = index_chain(&W.by_size, h); l; l = l->next) {
+        if (((Bucket*)l)->size == size) return (Bucket*)l;
+    }
+    Bucket* b = calloc(1, sizeof(Bucket));
+    if (!b) {
+        fprintf(stderr, "Memory allocation failed for watch index\n");
+        exit(EXIT_FAILURE);
+    }
+    b->link.hash = h;
+    b->size = size;
+    index_insert(&W.by_size, &b->link);
+    return b;
+}
+
+static void group_add(WFile* f) {
+    uint64_t h = hash_content(f->size, f->hash);
+    Group* g = NULL;
+    for (Link* l = index_chain(&W.by_digest, h); l && !g; l = l->next) {
+        Group* c = (Group*)l;
+        if (c->size == f->size && memcmp(c->hash, f->hash, DIGEST_LEN) == 0) g = c;
+    }
+    if (!g) {
+        if (!(g = calloc(1, sizeof(Group)))) {
+            fprintf(stderr, "Memory allocation failed for watch index\n");
+            exit(EXIT_FAILURE);
+        }
+        g->link.hash = h;
+        g->size = f->size;
+        memcpy(g->hash, f->hash, DIGEST_LEN);
+        index_insert(&W.by_digest, &g->link);
+    }
+    f->group = g;
+    f->prev_dup = NULL;
+    f->next_dup = g->members;
+    if (g->members) g->members->prev_dup = f;
+    g->members = f;
+    g->count++;
+}
+
+static void file_remove(WFile* f) {
+    index_remove(&W.by_path, &f->link);
+
+    Bucket* b = f->bucket;
+    if (f->prev_size) f->prev_size->next_size = f->next_size;
+    else b->members = f->next_size;
+    if (f->next_size) f->next_size->prev_size = f->prev_size;
+    if (!b->members) {
+        index_remove(&W.by_size, &b->link);
+        free(b);
+    }
+
+    Group* g = f->group;
+    if (g) {
+        if (f->prev_dup) f->prev_dup->next_dup = f->next_dup;
+        else g->members = f->next_dup;
+        if (f->next_dup) f->next_dup->prev_dup = f->prev_dup;
+        if (--g->count == 0) {
+            index_remove(&W.by_digest, &g->link);
+            free(g);
+        }
+    }
+
+    free(f->path);
+    free(f);
+    W.files--;
+}
+
+// Adds (or replaces) the record for `path`. `digest` is its full digest
+// if already known, NULL otherwise.
+static WFile* file_add(const char* path, const struct stat* sb, const unsigned char* digest) {
+    WFile* old = file_find(path);
+    if (old) file_remove(old);
+
+    WFile* f = calloc(1, sizeof(WFile));
+    if (!f || !(f->path = strdup(path))) {
+        fprintf(stderr, "Memory allocation failed for watch index\n");
+        exit(EXIT_FAILURE);
+    }
+    f->link.hash = hash_path(path);
+    f->size = sb->st_size;
+    f->dev = sb->st_dev;
+    f->ino = sb->st_ino;
+    f->mtime_ns = (int64_t)sb->st_mtim.tv_sec * 1000000000 + sb->st_mtim.tv_nsec;
+    index_insert(&W.by_path, &f->link);
+
+    Bucket* b = bucket_get(f->size);
+    f->bucket = b;
+    f->next_size = b->members;
+    if (b->members) b->members->prev_size = f;
+    b->members = f;
+
+    if (digest) {
+        memcpy(f->hash, digest, DIGEST_LEN);
+        f->hashed = 1;
+        group_add(f);
+    }
+    W.files++;
+    return f;
+}
+
+// Hashes every unhashed member of the bucket once it holds two inodes.
+// Members the initial scan eliminated by their head/tail hash are only
+// read again when a new file of their size arrives.
+static void settle_bucket(Bucket* b) {
+    WFile* first = b->members;
+    WFile* other = first ? first->next_size : NULL;
+    while (other && other->dev == first->dev && other->ino == first->ino) other = other->next_size;
+    if (!other) return;
+
+    for (WFile* f = b->members; f; f = f->next_size) {
+        if (f->hashed) continue;
+        if (hash_file(W.ctx, f->path, f->hash) == 0) {
+            f->hashed = 1;
+            group_add(f);
+            W.hashes++;
+        }
+    }
+}
+
+// Brings the record for `path` in line with the file system
+static void update_file(const char* path) {
+    struct stat sb;
+    WFile* f = file_find(path);
+    if (lstat(path, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+        if (f) file_remove(f);
+        return;
+    }
+    int64_t mtime_ns = (int64_t)sb.st_mtim.tv_sec * 1000000000 + sb.st_mtim.tv_nsec;
+    if (f && f->dev == (uint64_t)sb.st_dev && f->ino == (uint64_t)sb.st_ino &&
+        f->size == (uint64_t)sb.st_size && f->mtime_ns == mtime_ns) {
+        return; // Closed without changes
+    }
+    f = file_add(path, &sb, NULL);
+    settle_bucket(f->bucket);
+}
+
+// ---- watches ----
+
+static void add_watch(const char* path) {
+    int wd = inotify_add_watch(W.ifd, path, WATCH_MASK);
+    if (wd < 0) {
+        fprintf(stderr, "Cannot watch %s: %s%s\n", path, strerror(errno),
+                errno == ENOSPC ? " (raise fs.inotify.max_user_watches)" : "");
+        return;
+    }
+    if (wd >= W.wd_cap) {
+        int cap = W.wd_cap ? W.wd_cap : 64;
+        while (cap <= wd) cap *= 2;
+        W.wd_paths = realloc(W.wd_paths, sizeof(char*) * cap);
+        if (!W.wd_paths) {
+            fprintf(stderr, "Memory allocation failed for watches\n");
+            exit(EXIT_FAILURE);
+        }
+        memset(W.wd_paths + W.wd_cap, 0, sizeof(char*) * (cap - W.wd_cap));
+        W.wd_cap = cap;
+    }
+    free(W.wd_paths[wd]);
+    if (!(W.wd_paths[wd] = strdup(path))) {
+        fprintf(stderr, "Memory allocation failed for watches\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static int add_tree_entry(const char* path, const struct stat* sb, int type, struct FTW* ftw) {
+    (void)ftw;
+    if (type == FTW_D) {
+        add_watch(path);
+    } else if (type == FTW_F && W.index_files && S_ISREG(sb->st_mode)) {
+        Bucket* b = file_add(path, sb, NULL)->bucket;
+        if (!b->added) {
+            b->added = 1;
+            b->next_added = W.added;
+            W.added = b;
+        }
+    }
+    return 0;
+}
+
+// Watches every directory under `path`; with W.index_files its files are
+// indexed too, and hashed where their size calls for it. Only the buckets
+// the new files landed in are settled, so a directory moved in costs the
+// hashing of its own files' buckets, not of the whole index. (A bucket
+// never empties while it holds one of the new files, so none is freed
+// before it is settled.)
+static void add_tree(const char* path) {
+    W.added = NULL;
+    if (nftw(path, add_tree_entry, NFTW_FDS, FTW_PHYS) != 0 && errno != ENOENT) {
+        fprintf(stderr, "Cannot scan %s: %s\n", path, strerror(errno));
+    }
+    while (W.added) {
+        Bucket* b = W.added;
+        W.added = b->next_added;
+        b->added = 0;
+        settle_bucket(b);
+    }
+}
+
+static int under(const char* path, const char* dir, size_t dirlen) {
+    return strncmp(path, dir, dirlen) == 0 && (path[dirlen] == '/' || path[dirlen] == '\0');
+}
+
+// Forgets a directory that left the tree, with everything below it
+static void remove_tree(const char* dir) {
+    size_t len = strlen(dir);
+    for (size_t i = 0; i < W.by_path.nslots; i++) {
+        for (Link* l = W.by_path.slots[i]; l;) {
+            Link* next = l->next;
+            if (under(((WFile*)l)->path, dir, len)) file_remove((WFile*)l);
+            l = next;
+        }
+    }
+    for (int wd = 0; wd < W.wd_cap; wd++) {
+        if (W.wd_paths[wd] && under(W.wd_paths[wd], dir, len)) {
+            inotify_rm_watch(W.ifd, wd);
+            free(W.wd_paths[wd]);
+            W.wd_paths[wd] = NULL;
+        }
+    }
+}
+
+static void drop_files(void) {
+    for (size_t i = 0; i < W.by_path.nslots; i++) {
+        for (Link* l = W.by_path.slots[i]; l;) {
+            Link* next = l->next;
+            file_remove((WFile*)l);
+            l = next;
+        }
+    }
+}
+
+// Events were lost: start the index over from a fresh scan. Every file is
+// new to the emptied index, so every bucket is settled again.
+static void rescan(void) {
+    drop_files();
+    W.index_files = 1;
+    for (int r = 0; r < W.nroots; r++) add_tree(W.roots[r]);
+    W.rescans++;
+}
+
+static void handle_event(const struct inotify_event* ev) {
+    W.events++;
+    if (ev->mask & IN_Q_OVERFLOW) {
+        fprintf(stderr, "inotify queue overflowed; rescanning\n");
+        rescan();
+        return;
+    }
+    if (ev->wd < 0 || ev->wd >= W.wd_cap || !W.wd_paths[ev->wd]) return;
+    if (ev->mask & IN_IGNORED) { // Directory gone or unwatched
+        free(W.wd_paths[ev->wd]);
+        W.wd_paths[ev->wd] = NULL;
+        return;
+    }
+    if (ev->len == 0) return;
+
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", W.wd_paths[ev->wd], ev->name) >= (int)sizeof(path)) {
+        fprintf(stderr, "Path too long: %s\n", ev->name);
+        return;
+    }
+    if (ev->mask & IN_ISDIR) {
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+            W.index_files = 1;
+            add_tree(path);
+        } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            remove_tree(path);
+        }
+    } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        WFile* f = file_find(path);
+        if (f) file_remove(f);
+    } else {
+        update_file(path); // IN_CREATE (including link()), IN_CLOSE_WRITE, IN_MOVED_TO
+    }
+}
+
+static void read_events(void) {
+    char buf[EVENT_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t n = read(W.ifd, buf, sizeof(buf));
+        if (n <= 0) return; // EAGAIN: queue drained
+        for (char* p = buf; p < buf + n;) {
+            const struct inotify_event* ev = (const struct inotify_event*)p;
+            handle_event(ev);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+}
+
+void watch_start(char* const* roots, int nroots) {
+    W.ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (W.ifd < 0) {
+        fprintf(stderr, "Cannot start inotify: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    W.roots = roots;
+    W.nroots = nroots;
+    W.index_files = 0; // The initial scan supplies the files
+    for (int r = 0; r < nroots; r++) add_tree(roots[r]);
+}
+
+// ---- queries ----
+
+static int compare_file_paths(const void* a, const void* b) {
+    return strcmp((*(WFile* const*)a)->path, (*(WFile* const*)b)->path);
+}
+
+static int compare_file_inodes(const void* a, const void* b) {
+    const WFile* fileA = *(WFile* const*)a;
+    const WFile* fileB = *(WFile* const*)b;
+    if (fileA->dev != fileB->dev) return (fileA->dev > fileB->dev) ? 1 : -1;
+    return (fileA->ino > fileB->ino) - (fileA->ino < fileB->ino);
+}
+
+// Members of `g` sorted by path into *out if they span two inodes, else 0
+static int group_members(const Group* g, WFile*** out) {
+    if (g->count < 2) return 0;
+    WFile** members = malloc(sizeof(WFile*) * g->count);
+    if (!members) {
+        fprintf(stderr, "Memory allocation failed for watch query\n");
+        exit(EXIT_FAILURE);
+    }
+    int n = 0;
+    for (WFile* f = g->members; f; f = f->next_dup) members[n++] = f;
+
+    qsort(members, n, sizeof(WFile*), compare_file_inodes);
+    int inodes = 1;
+    for (int i = 1; i < n; i++) {
+        if (compare_file_inodes(&members[i - 1], &members[i]) != 0) inodes++;
+    }
+    if (inodes < 2) {
+        free(members);
+        return 0;
+    }
+    qsort(members, n, sizeof(WFile*), compare_file_paths);
+    *out = members;
+    return n;
+}
+
+typedef struct {
+    WFile** members;
+    int count;
+} WGroup;
+
+static int compare_wgroups(const void* a, const void* b) {
+    return strcmp(((const WGroup*)a)->members[0]->path, ((const WGroup*)b)->members[0]->path);
+}
+
+static void print_wgroup(FILE* out, const WGroup* group) {
+    for (int i = 0; i < group->count; i++) {
+        fprintf(out, "%d %d %s\n", group->count, i + 1, group->members[i]->path);
+    }
+}
+
+// Collects every duplicate group; the caller frees each one's members
+static int collect_groups(WGroup** out) {
+    WGroup* groups = malloc(sizeof(WGroup) * (W.by_digest.count + 1));
+    if (!groups) {
+        fprintf(stderr, "Memory allocation failed for watch query\n");
+        exit(EXIT_FAILURE);
+    }
+    int ngroups = 0;
+    for (size_t i = 0; i < W.by_digest.nslots; i++) {
+        for (Link* l = W.by_digest.slots[i]; l; l = l->next) {
+            WFile** members;
+            int n = group_members((Group*)l, &members);
+            if (n > 0) groups[ngroups++] = (WGroup){ members, n };
+        }
+    }
+    *out = groups;
+    return ngroups;
+}
+
+static void free_groups(WGroup* groups, int ngroups) {
+    for (int g = 0; g < ngroups; g++) free(groups[g].members);
+    free(groups);
+}
+
+// Every duplicate group, ordered by first path like the batch output
+static void query_groups(FILE* out) {
+    WGroup* groups;
+    int ngroups = collect_groups(&groups);
+    qsort(groups, ngroups, sizeof(WGroup), compare_wgroups);
+    for (int g = 0; g < ngroups; g++) print_wgroup(out, &groups[g]);
+    free_groups(groups, ngroups);
+}
+
+static void query_stats(FILE* out) {
+    WGroup* groups;
+    int ngroups = collect_groups(&groups);
+    free_groups(groups, ngroups);
+    int dirs = 0;
+    for (int wd = 0; wd < W.wd_cap; wd++) dirs += W.wd_paths[wd] != NULL;
+    fprintf(out, "files            %ld\n", W.files);
+    fprintf(out, "directories      %d\n", dirs);
+    fprintf(out, "duplicate groups %d\n", ngroups);
+    fprintf(out, "events           %ld\n", W.events);
+    fprintf(out, "files hashed     %ld\n", W.hashes);
+    fprintf(out, "rescans          %ld\n", W.rescans);
+}
+
+static void query_dups(FILE* out, const char* path) {
+    WFile* f = file_find(path);
+    WGroup group;
+    if (f && f->group && (group.count = group_members(f->group, &group.members)) > 0) {
+        print_wgroup(out, &group);
+        free(group.members);
+    }
+}
+
+// Answers the one request line a client sends, then hangs up
+static void serve_client(int cfd) {
+    struct timeval timeout = { QUERY_TIMEOUT_SECONDS, 0 };
+    setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    FILE* conn = fdopen(cfd, "r+");
+    if (!conn) {
+        close(cfd);
+        return;
+    }
+
+    char line[PATH_MAX + 16];
+    if (fgets(line, sizeof(line), conn)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        fseek(conn, 0, SEEK_CUR); // Switch the stream from reading to writing
+        if (strcmp(line, "groups") == 0) {
+            query_groups(conn);
+        } else if (strncmp(line, "dups ", 5) == 0) {
+            query_dups(conn, line + 5);
+        } else if (strcmp(line, "stats") == 0) {
+            query_stats(conn);
+        } else {
+            fprintf(conn, "unknown request (groups, dups PATH, stats)\n");
+        }
+    }
+    fclose(conn);
+}
+
+static void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+void watch_run(const FileTable* table, const char* socket_path) {
+    index_init(&W.by_path);
+    index_init(&W.by_size);
+    index_init(&W.by_digest);
+    W.ctx = digest_new(digest_algo);
+
+    // The initial scan's digests are reused; lockstep class keys are not
+    // digests, so main.c turns that stage off in watch mode
+    char path[PATH_MAX];
+    for (size_t i = 0; i < table->count; i++) {
+        const FileEntry* entry = &table->entries[i];
+        if (entry_path(entry, path, sizeof(path)) != 0) continue;
+        struct stat sb;
+        memset(&sb, 0, sizeof(sb));
+        sb.st_size = entry->size;
+        sb.st_dev = unpack_dev(entry->dev);
+        sb.st_ino = entry->ino;
+        int64_t mtime_ns = entry_mtime(entry);
+        sb.st_mtim.tv_sec = mtime_ns / 1000000000;
+        sb.st_mtim.tv_nsec = mtime_ns % 1000000000;
+        file_add(path, &sb, entry->hashed ? entry->hash : NULL);
+    }
+    read_events(); // Changes made during the initial scan
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    if (lfd < 0 || bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(lfd, 16) != 0) {
+        fprintf(stderr, "Cannot listen on %s: %s\n", socket_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop; // No SA_RESTART, so poll() returns
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN); // A client that hangs up early must not kill us
+    fprintf(stderr, "watching %ld files; queries on %s\n", W.files, socket_path);
+
+    while (!stop_requested) {
+        struct pollfd fds[2] = { { W.ifd, POLLIN, 0 }, { lfd, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "poll failed: %s\n", strerror(errno));
+            break;
+        }
+        if (fds[0].revents & POLLIN) read_events();
+        if (fds[1].revents & POLLIN) {
+            int cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+            if (cfd >= 0) serve_client(cfd);
+        }
+    }
+
+    close(lfd);
+    unlink(socket_path);
+    close(W.ifd);
+    drop_files();
+    for (int wd = 0; wd < W.wd_cap; wd++) free(W.wd_paths[wd]);
+    free(W.wd_paths);
+    free(W.by_path.slots);
+    free(W.by_size.slots);
+    free(W.by_digest.slots);
+    digest_free(W.ctx);
+}
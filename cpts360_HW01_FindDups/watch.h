@@ -0,0 +1,26 @@
+//
+//  watch.h
+//  PA01_FindDups
+//
+//  Watch mode (--watch): keeps a live duplicate index of the scanned trees
+//  up to date from inotify events and answers queries on a Unix socket.
+//
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "finddups.h"
+
+// Adds an inotify watch to every directory under `roots`. Called before
+// the initial scan so that changes made during it are queued, not lost.
+void watch_start(char* const* roots, int nroots);
+
+// Builds the index from the initial scan in `table` (full digests are
+// reused; files never hashed are hashed once another file of their size
+// shows up), then applies events and serves queries on `socket_path`
+// until SIGINT or SIGTERM. A client sends one line per connection:
+//   groups       every duplicate group, in the usual output format
+//   dups PATH    the group PATH belongs to
+//   stats        index and event counters
+void watch_run(const FileTable* table, const char* socket_path);
+
+#endif // WATCH_H
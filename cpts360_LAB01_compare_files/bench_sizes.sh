@@ -0,0 +1,52 @@
+#!/bin/bash
+#
+# Sweeps file sizes to find where mmap (-m) starts beating read (-r) when
+# the files are already in the page cache, which is what MMAP_MIN_SIZE
+# in compare_files.h is set from. Each pair is identical, so both files
+# are compared to the end, and small sizes are repeated enough times to
+# rise above the cost of starting the program.
+#
+# usage: ./bench_sizes.sh [scratch-dir] [sizes-in-KiB...]
+#
+
+PROGRAM=${PROGRAM:-./compare_files}
+DIR=${1:-/tmp/compare_files_sizes}
+shift 2>/dev/null
+SIZES=${*:-"16 64 256 1024 4096 16384 65536 262144 1048576"}
+
+mkdir -p "$DIR" || exit 1
+
+# Prints the wall time of `reps` runs in nanoseconds
+run() {
+    reps=$1
+    shift
+    start=$(date +%s%N)
+    for ((i = 0; i < reps; i++)); do
+        "$PROGRAM" "$@" > /dev/null
+    done
+    end=$(date +%s%N)
+    echo $((end - start))
+}
+
+echo "KiB,reps,read_us,mmap_us,mmap/read"
+for kib in $SIZES; do
+    if [ "$(stat -c %s "$DIR/a$kib" 2>/dev/null)" != $((kib * 1024)) ]; then
+        head -c $((kib * 1024)) /dev/urandom > "$DIR/a$kib" || exit 1
+        cp "$DIR/a$kib" "$DIR/b$kib" || exit 1
+    fi
+    reps=$((262144 / kib))
+    reps=$((reps < 1 ? 1 : reps > 200 ? 200 : reps))
+    "$PROGRAM" "$DIR/a$kib" "$DIR/b$kib" > /dev/null # load the cache
+
+    # Alternate the two modes so drift in machine load hits both alike
+    read_ns=0
+    mmap_ns=0
+    for round in 1 2 3; do
+        read_ns=$((read_ns + $(run $reps -r "$DIR/a$kib" "$DIR/b$kib")))
+        mmap_ns=$((mmap_ns + $(run $reps -m "$DIR/a$kib" "$DIR/b$kib")))
+    done
+    read_us=$((read_ns / 3 / reps / 1000))
+    mmap_us=$((mmap_ns / 3 / reps / 1000))
+    ratio=$((mmap_ns * 100 / read_ns))
+    printf '%d,%d,%d,%d,%d.%02d\n' "$kib" "$reps" "$read_us" "$mmap_us" $((ratio / 100)) $((ratio % 100))
+done
@@ -0,0 +1,144 @@
+// The identical prefix is skipped with compareFilesAt(), which runs at
+// memory speed; the block scan starts at the block holding the first
+// difference. From there both files are read in lockstep, one block at a
+// time, and each block of the new file is compared byte for byte with
+// the old file's block at the same offset.
+//
+// Both files are on hand, so blocks are compared directly rather than
+// through checksums: that is exact, and cheaper than hashing both sides.
+#include <stdlib.h>   // for posix_memalign(), realloc() and free()
+#include <string.h>   // for strerror()
+#include <errno.h>    // for errno
+#include <fcntl.h>    // for open()
+#include <unistd.h>   // for lseek() and close()
+#include <sys/stat.h> // for fstat()
+
+#include "eprintf.h"       // for eprintf_fail()
+#include "memdiff.h"       // for firstDifference()
+#include "compare_files.h" // for compareFilesAt() and readBlock()
+
+#include "compare_delta.h"
+
+
+// Adds a block to the delta, merging it into the last range if they touch.
+static void addBlock(Delta *delta, long long *capacity, long long offset, long long length)
+{
+    if (delta->nranges > 0) {
+        ByteRange *last = &delta->ranges[delta->nranges - 1];
+        if (last->offset + last->length == offset) {
+            last->length += length;
+            return;
+        }
+    }
+    if (delta->nranges == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        delta->ranges = realloc(delta->ranges, *capacity * sizeof(ByteRange));
+        if (!delta->ranges)
+            eprintf_fail("Out of memory\n");
+    }
+    delta->ranges[delta->nranges].offset = offset;
+    delta->ranges[delta->nranges].length = length;
+    delta->nranges++;
+}
+
+
+Delta compareDelta(char *fname0, char *fname1, long long blockSize)
+{
+    Delta delta = { 0, 0, blockSize, 0, NULL };
+    long long capacity = 0;
+    struct stat sb0, sb1;
+    FileDiff where;
+    char *buf0, *buf1;
+    int fd0, fd1;
+
+    fd0 = open(fname0, O_RDONLY);
+    if (fd0 < 0)
+        eprintf_fail("Failed to open file: %s", fname0);
+    fd1 = open(fname1, O_RDONLY);
+    if (fd1 < 0) {
+        close(fd0);
+        eprintf_fail("Failed to open file: %s", fname1);
+    }
+    if (fstat(fd0, &sb0) < 0 || fstat(fd1, &sb1) < 0)
+        eprintf_fail("Failed to stat files: %s, %s: %s\n", fname0, fname1, strerror(errno));
+    if (!S_ISREG(sb0.st_mode) || !S_ISREG(sb1.st_mode))
+        eprintf_fail("A delta needs two regular files: %s, %s\n", fname0, fname1);
+    delta.oldSize = sb0.st_size;
+    delta.newSize = sb1.st_size;
+
+    if (compareFilesAt(fname0, fname1, &where)) {
+        close(fd0);
+        close(fd1);
+        return delta;
+    }
+
+    if (posix_memalign((void **)&buf0, BLOCK_ALIGN, blockSize) != 0
+        || posix_memalign((void **)&buf1, BLOCK_ALIGN, blockSize) != 0)
+        eprintf_fail("Out of memory\n");
+    long long offset = where.offset / blockSize * blockSize;
+    if (lseek(fd0, offset, SEEK_SET) < 0 || lseek(fd1, offset, SEEK_SET) < 0)
+        eprintf_fail("Failed to seek files: %s, %s: %s\n", fname0, fname1, strerror(errno));
+    posix_fadvise(fd0, offset, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fd1, offset, 0, POSIX_FADV_SEQUENTIAL);
+
+    // Past the old file's end its reads come back short or empty, so
+    // every remaining block of the new file counts as different.
+    while (1) {
+        size_t n1 = readBlock(fd1, buf1, blockSize, fname1);
+        if (n1 == 0)
+            break;
+        size_t n0 = readBlock(fd0, buf0, blockSize, fname0);
+        if (n0 < n1 || firstDifference(buf0, buf1, n1) < n1)
+            addBlock(&delta, &capacity, offset, n1);
+        offset += n1;
+    }
+
+    free(buf0);
+    free(buf1);
+    close(fd0);
+    close(fd1);
+    return delta;
+}
+
+
+void freeDelta(Delta *delta)
+{
+    free(delta->ranges);
+    delta->ranges = NULL;
+    delta->nranges = 0;
+}
+
+
+void writeDeltaJson(FILE *out, const Delta *delta)
+{
+    fprintf(out, "{\"old_size\": %lld, \"new_size\": %lld, \"block_size\": %lld, \"ranges\": [",
+            delta->oldSize, delta->newSize, delta->blockSize);
+    for (long long i = 0; i < delta->nranges; i++)
+        fprintf(out, "%s[%lld, %lld]", i ? ", " : "",
+                delta->ranges[i].offset, delta->ranges[i].length);
+    fprintf(out, "]}\n");
+}
+
+
+// Writes `value` as 8 bytes, least significant first, on any host.
+static void put64(FILE *out, long long value)
+{
+    unsigned long long v = value;
+
+    for (int i = 0; i < 8; i++)
+        putc((v >> (8 * i)) & 0xff, out);
+}
+
+
+void writeDeltaBinary(FILE *out, const Delta *delta)
+{
+    fwrite("CFDELTA1", 1, 8, out);
+    put64(out, delta->oldSize);
+    put64(out, delta->newSize);
+    put64(out, delta->blockSize);
+    put64(out, delta->nranges);
+    for (long long i = 0; i < delta->nranges; i++) {
+        put64(out, delta->ranges[i].offset);
+        put64(out, delta->ranges[i].length);
+    }
+}
@@ -0,0 +1,44 @@
+// Delta report: which fixed-size blocks of a file must be rewritten to
+// turn an old copy of it into the new one in place.
+#ifndef COMPARE_DELTA_INCLUDED
+#define COMPARE_DELTA_INCLUDED
+
+#include <stdio.h> // for FILE
+
+// Default block size: small enough that a change of a few bytes costs
+// little to resend, large enough to keep the range list short.
+#define DELTA_BLOCK_SIZE (64 * 1024)
+
+// A run of bytes of the new file, starting at `offset`
+typedef struct {
+    long long offset;
+    long long length;
+} ByteRange;
+
+// The result of compareDelta()
+typedef struct {
+    long long oldSize, newSize;
+    long long blockSize;
+    long long nranges;
+    ByteRange *ranges; // in offset order, adjacent blocks merged
+} Delta;
+
+// Compares the old file `fname0` with the new file `fname1` one
+// `blockSize` block at a time and lists the blocks of the new file whose
+// bytes differ from the old file's at the same offset, including any part
+// of the new file past the old one's end. Writing those ranges into the
+// old file and truncating it to `newSize` reproduces the new file. Free
+// the result with freeDelta().
+Delta compareDelta(char *fname0, char *fname1, long long blockSize);
+void freeDelta(Delta *delta);
+
+// Writes a delta as one line of JSON:
+//   {"old_size": N, "new_size": N, "block_size": N, "ranges": [[offset, length], ...]}
+void writeDeltaJson(FILE *out, const Delta *delta);
+
+// Writes a delta in binary: the 8 bytes "CFDELTA1", then the old size,
+// new size, block size and range count, then an offset and a length per
+// range, all as 64-bit little-endian integers.
+void writeDeltaBinary(FILE *out, const Delta *delta);
+
+#endif // COMPARE_DELTA_INCLUDED
@@ -4,6 +4,50 @@
 #ifndef COMPARE_FILES_INCLUDED
 #define COMPARE_FILES_INCLUDED
 
+#include <stddef.h> // for size_t
+
+// Bytes read from each file per step. Anything from 256 KiB to 1 MiB
+// runs at about the same speed; much smaller and the read() calls start
+// to cost, much larger and the two buffers stop fitting in the L2 cache.
+#define BLOCK_SIZE (512 * 1024)
+
+// Buffers are aligned to a page so the kernel can copy whole pages.
+#define BLOCK_ALIGN 4096
+
+// Below this size, setting up and tearing down two mappings costs about
+// as much as the copies read(2) makes; from here up mapping was 15-30%
+// faster with a warm page cache (see bench_sizes.sh).
+#define MMAP_MIN_SIZE (64 * 1024)
+
+// Regular files at least this large (the smaller of the two) are mapped
+// with mmap(2) instead of read. 0 maps every file, -1 none.
+extern long long mmapMinSize;
+
+// Returns 1 if the files named `fname0` and `fname1` have identical
+// contents and 0 if they do not. Exits with an error message if either
+// file cannot be opened or read.
 int compareFiles(char *fname0, char *fname1);
 
+// Where two files first differ. `offset` counts bytes from 0; `line` and
+// `column` count from 1, in file 0, with lines ending at '\n'. If one file
+// is a prefix of the other, the difference is just past the shorter one's
+// end. All three are -1 for identical files.
+typedef struct {
+    long long offset;
+    long long line;
+    long long column;
+} FileDiff;
+
+// Like compareFiles(), and also fills in `*where` (unless it is NULL).
+int compareFilesAt(char *fname0, char *fname1, FileDiff *where);
+
+// Reads up to `size` bytes, retrying short reads, so that files are
+// always compared in equal-sized blocks. Returns fewer than `size` bytes
+// only at end of file, and exits with an error message on a read error.
+size_t readBlock(int fd, char *buf, size_t size, char *fname);
+
+// The original one-character-at-a-time version, kept as the baseline for
+// bench_compare.sh. Same contract as compareFiles().
+int compareFilesGetc(char *fname0, char *fname1);
+
 #endif // COMPARE_FILES_INCLUDED
@@ -0,0 +1,168 @@
+// All the files are read in lockstep, one block each per round. Files
+// start out in one group per size (files of different sizes cannot
+// match), and each round splits every group by the contents of the block
+// just read. A file left alone in its group is settled and is not read
+// any further; a group whose files all end together is a class.
+//
+// Names for the same inode are read once: the later names take the class
+// of the first. Memory is one BLOCK_SIZE buffer per file still being read.
+#include <stdlib.h>   // for malloc(), posix_memalign() and free()
+#include <string.h>   // for memcmp() and strerror()
+#include <errno.h>    // for errno
+#include <fcntl.h>    // for open()
+#include <unistd.h>   // for close()
+#include <sys/stat.h> // for fstat()
+
+#include "eprintf.h"       // for eprintf_fail()
+#include "compare_files.h" // for readBlock() and BLOCK_SIZE
+
+#include "compare_many.h"
+
+
+// One file of the comparison
+typedef struct {
+    int fd;          // -1 once the file is settled (or never opened)
+    char *buf;
+    size_t n;        // bytes in `buf` this round
+    int group;       // named after its first file, which is never settled later
+    int sameAs;      // earlier file with the same inode, or -1
+    struct stat sb;
+} Member;
+
+
+// Closes a settled file and releases its buffer.
+static void settle(Member *m)
+{
+    close(m->fd);
+    free(m->buf);
+    m->fd = -1;
+    m->buf = NULL;
+}
+
+
+int compareManyFiles(char *fnames[], int nfiles, int classOf[])
+{
+    Member *members;
+    int *reps, *groupSize, *newGroup;
+    int allRegular = 1;
+    int active;
+
+    members = malloc(nfiles * sizeof(Member));
+    reps = malloc(nfiles * sizeof(int));
+    groupSize = malloc(nfiles * sizeof(int));
+    newGroup = malloc(nfiles * sizeof(int));
+    if (!members || !reps || !groupSize || !newGroup)
+        eprintf_fail("Out of memory\n");
+
+    for (int i = 0; i < nfiles; i++) {
+        Member *m = &members[i];
+        m->fd = open(fnames[i], O_RDONLY);
+        if (m->fd < 0)
+            eprintf_fail("Failed to open file: %s\n", fnames[i]);
+        if (fstat(m->fd, &m->sb) < 0)
+            eprintf_fail("Failed to stat file: %s: %s\n", fnames[i], strerror(errno));
+        if (!S_ISREG(m->sb.st_mode))
+            allRegular = 0;
+        m->buf = NULL;
+        m->sameAs = -1;
+        for (int j = 0; j < i && m->sameAs < 0; j++)
+            if (members[j].sameAs < 0 && members[j].sb.st_dev == m->sb.st_dev
+                && members[j].sb.st_ino == m->sb.st_ino)
+                m->sameAs = j;
+        if (m->sameAs >= 0) {
+            close(m->fd);
+            m->fd = -1;
+        }
+    }
+
+    // First split: by size, when the sizes mean anything
+    for (int i = 0; i < nfiles; i++)
+        groupSize[i] = 0;
+    for (int i = 0; i < nfiles; i++) {
+        Member *m = &members[i];
+        if (m->sameAs >= 0)
+            continue;
+        m->group = i;
+        for (int j = 0; j < i; j++) {
+            if (members[j].sameAs < 0 && members[j].group == j
+                && (!allRegular || members[j].sb.st_size == m->sb.st_size)) {
+                m->group = j;
+                break;
+            }
+        }
+        groupSize[m->group]++;
+    }
+    for (int i = 0; i < nfiles; i++) {
+        Member *m = &members[i];
+        if (m->fd < 0)
+            continue;
+        if (groupSize[m->group] == 1)
+            settle(m);
+        else if (posix_memalign((void **)&m->buf, BLOCK_ALIGN, BLOCK_SIZE) != 0)
+            eprintf_fail("Out of memory\n");
+        else
+            posix_fadvise(m->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    do {
+        int nreps = 0;
+
+        for (int i = 0; i < nfiles; i++)
+            if (members[i].fd >= 0)
+                members[i].n = readBlock(members[i].fd, members[i].buf, BLOCK_SIZE, fnames[i]);
+
+        // Each file joins the first file of its old group whose block
+        // matches its own, or becomes the first file of a new group.
+        for (int i = 0; i < nfiles; i++) {
+            Member *m = &members[i];
+            if (m->fd < 0)
+                continue;
+            newGroup[i] = i;
+            for (int r = 0; r < nreps; r++) {
+                Member *rep = &members[reps[r]];
+                if (rep->group == m->group && rep->n == m->n
+                    && memcmp(rep->buf, m->buf, m->n) == 0) {
+                    newGroup[i] = reps[r];
+                    break;
+                }
+            }
+            if (newGroup[i] == i) {
+                reps[nreps++] = i;
+                groupSize[i] = 0;
+            }
+            groupSize[newGroup[i]]++;
+        }
+
+        // A file alone in its group is done, and so is one that has
+        // ended (with the rest of its group, which read the same bytes).
+        active = 0;
+        for (int i = 0; i < nfiles; i++) {
+            Member *m = &members[i];
+            if (m->fd < 0)
+                continue;
+            m->group = newGroup[i];
+            if (groupSize[m->group] == 1 || m->n < BLOCK_SIZE)
+                settle(m);
+            else
+                active++;
+        }
+    } while (active > 0);
+
+    // Number the classes in order of their first file, which is the
+    // file each group is named after.
+    int nclasses = 0;
+    for (int i = 0; i < nfiles; i++) {
+        if (members[i].sameAs >= 0)
+            classOf[i] = classOf[members[i].sameAs];
+        else if (members[i].group == i)
+            classOf[i] = nclasses++;
+        else
+            classOf[i] = classOf[members[i].group];
+    }
+
+    free(members);
+    free(reps);
+    free(groupSize);
+    free(newGroup);
+    return nclasses;
+}
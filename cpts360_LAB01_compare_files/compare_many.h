@@ -0,0 +1,14 @@
+// N-way comparison: sorts many files into groups of identical ones in a
+// single pass, instead of comparing them two at a time.
+#ifndef COMPARE_MANY_INCLUDED
+#define COMPARE_MANY_INCLUDED
+
+// Compares the `nfiles` files named in `fnames` and stores in
+// `classOf[i]` the class of file i: two files get the same class exactly
+// when their contents are identical. Classes are numbered from 0 in order
+// of their first file. Returns the number of classes. Every file is read
+// at most once, and no further than needed to set it apart from all the
+// others. Exits with an error message if a file cannot be opened or read.
+int compareManyFiles(char *fnames[], int nfiles, int classOf[]);
+
+#endif // COMPARE_MANY_INCLUDED
@@ -0,0 +1,202 @@
+// The files are split into RANGE_SIZE ranges, which threads claim in
+// order from a shared counter and compare block by block with pread(2).
+// The lowest difference found so far is kept in an atomic, and no thread
+// starts a range or a block at or past it. A range below the difference
+// is never cut short, so once every thread is done the atomic holds the
+// first difference, the same one compareFilesAt() would find.
+//
+// For line numbers each range also counts its newlines (up to the
+// difference, in the range that holds it); the line of the difference
+// is one plus the newlines of all the ranges before it.
+#include <stdlib.h>    // for malloc(), posix_memalign() and free()
+#include <string.h>    // for strerror()
+#include <errno.h>     // for errno and EINTR
+#include <fcntl.h>     // for open()
+#include <unistd.h>    // for pread() and close()
+#include <pthread.h>   // for pthread_create() and pthread_join()
+#include <stdatomic.h> // for the shared range counter and difference
+#include <sys/stat.h>  // for fstat()
+
+#include "eprintf.h" // for eprintf_fail()
+#include "memdiff.h" // for firstDifference() and countNewlines()
+
+#include "compare_parallel.h"
+
+
+// Bytes per claimed range: large enough that each thread reads long
+// sequential runs, small enough that the last ranges balance out.
+#define RANGE_SIZE (16 * 1024 * 1024)
+
+// Newlines in one range, kept only when line numbers are wanted
+typedef struct {
+    long long newlines;
+    long long lastNewline; // offset of the last one, if there are any
+} RangeLines;
+
+// Shared by all the threads of one comparison
+typedef struct {
+    int fd0, fd1;
+    char *fname0, *fname1;
+    long long common;      // bytes present in both files
+    long long nranges;
+    atomic_llong nextRange;
+    atomic_llong firstDiff; // lowest differing offset found, or `common`
+    RangeLines *lines;      // one per range, or NULL
+} SharedCompare;
+
+
+// Reads exactly `size` bytes at `offset` (the caller never asks for
+// bytes past the end of the file).
+static void preadFull(int fd, char *buf, size_t size, long long offset, char *fname)
+{
+    size_t total = 0;
+
+    while (total < size) {
+        ssize_t n = pread(fd, buf + total, size - total, offset + total);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            eprintf_fail("Failed to read file: %s: %s\n", fname, strerror(errno));
+        }
+        if (n == 0)
+            eprintf_fail("File shrank while being compared: %s\n", fname);
+        total += n;
+    }
+}
+
+
+// Lowers `shared->firstDiff` to `offset` unless another thread has
+// already found an earlier difference.
+static void recordDifference(SharedCompare *shared, long long offset)
+{
+    long long seen = atomic_load(&shared->firstDiff);
+
+    while (offset < seen
+           && !atomic_compare_exchange_weak(&shared->firstDiff, &seen, offset))
+        ; // `seen` now holds the other thread's value; try again
+}
+
+
+static void *compareRanges(void *arg)
+{
+    SharedCompare *shared = arg;
+    char *buf0, *buf1;
+    long long range;
+
+    if (posix_memalign((void **)&buf0, BLOCK_ALIGN, BLOCK_SIZE) != 0
+        || posix_memalign((void **)&buf1, BLOCK_ALIGN, BLOCK_SIZE) != 0)
+        eprintf_fail("Out of memory\n");
+
+    while ((range = atomic_fetch_add(&shared->nextRange, 1)) < shared->nranges) {
+        long long start = range * RANGE_SIZE;
+        long long end = start + RANGE_SIZE < shared->common ? start + RANGE_SIZE : shared->common;
+
+        if (start >= atomic_load(&shared->firstDiff))
+            break; // ranges are claimed in order, so every later one is too
+        for (long long offset = start; offset < end; offset += BLOCK_SIZE) {
+            if (offset >= atomic_load(&shared->firstDiff))
+                break;
+            size_t n = end - offset < BLOCK_SIZE ? end - offset : BLOCK_SIZE;
+            preadFull(shared->fd0, buf0, n, offset, shared->fname0);
+            preadFull(shared->fd1, buf1, n, offset, shared->fname1);
+            size_t same = firstDifference(buf0, buf1, n);
+
+            if (shared->lines) {
+                size_t last;
+                size_t newlines = countNewlines(buf0, same, &last);
+                if (newlines) {
+                    shared->lines[range].newlines += newlines;
+                    shared->lines[range].lastNewline = offset + last;
+                }
+            }
+            if (same < n) {
+                recordDifference(shared, offset + same);
+                break;
+            }
+        }
+    }
+
+    free(buf0);
+    free(buf1);
+    return NULL;
+}
+
+
+int compareFilesParallel(char *fname0, char *fname1, int nthreads, FileDiff *where)
+{
+    SharedCompare shared;
+    struct stat sb0, sb1;
+    pthread_t *threads;
+    int identical;
+
+    shared.fname0 = fname0;
+    shared.fname1 = fname1;
+    shared.fd0 = open(fname0, O_RDONLY);
+    if (shared.fd0 < 0)
+        eprintf_fail("Failed to open file: %s", fname0);
+    shared.fd1 = open(fname1, O_RDONLY);
+    if (shared.fd1 < 0) {
+        close(shared.fd0);
+        eprintf_fail("Failed to open file: %s", fname1);
+    }
+    if (fstat(shared.fd0, &sb0) < 0 || fstat(shared.fd1, &sb1) < 0)
+        eprintf_fail("Failed to stat files: %s, %s: %s\n", fname0, fname1, strerror(errno));
+
+    // Ranges need known sizes; the serial path handles everything else,
+    // including the same-inode and size short-circuits.
+    if (nthreads < 2 || !S_ISREG(sb0.st_mode) || !S_ISREG(sb1.st_mode)
+        || (sb0.st_dev == sb1.st_dev && sb0.st_ino == sb1.st_ino)
+        || (!where && sb0.st_size != sb1.st_size)) {
+        close(shared.fd0);
+        close(shared.fd1);
+        return compareFilesAt(fname0, fname1, where);
+    }
+
+    shared.common = sb0.st_size < sb1.st_size ? sb0.st_size : sb1.st_size;
+    shared.nranges = (shared.common + RANGE_SIZE - 1) / RANGE_SIZE;
+    atomic_init(&shared.nextRange, 0);
+    atomic_init(&shared.firstDiff, shared.common);
+    shared.lines = NULL;
+    if (where && shared.nranges > 0
+        && !(shared.lines = calloc(shared.nranges, sizeof(RangeLines))))
+        eprintf_fail("Out of memory\n");
+    if (nthreads > shared.nranges)
+        nthreads = shared.nranges > 0 ? shared.nranges : 1;
+
+    threads = malloc(nthreads * sizeof(pthread_t));
+    if (!threads)
+        eprintf_fail("Out of memory\n");
+    for (int i = 0; i < nthreads; i++)
+        if (pthread_create(&threads[i], NULL, compareRanges, &shared) != 0)
+            eprintf_fail("Failed to start compare thread\n");
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+
+    // Past the end of the shorter file counts as a difference too.
+    long long diff = atomic_load(&shared.firstDiff);
+    identical = diff == shared.common && sb0.st_size == sb1.st_size;
+
+    if (where && identical) {
+        where->offset = where->line = where->column = -1;
+    } else if (where) {
+        long long lines = 0, lineStart = 0;
+        long long diffRange = diff / RANGE_SIZE;
+
+        // When the shorter file ends on a range boundary, the difference
+        // is just past the last range.
+        for (long long r = 0; r <= diffRange && r < shared.nranges; r++) {
+            if (shared.lines[r].newlines) {
+                lines += shared.lines[r].newlines;
+                lineStart = shared.lines[r].lastNewline + 1;
+            }
+        }
+        where->offset = diff;
+        where->line = lines + 1;
+        where->column = diff - lineStart + 1;
+    }
+    free(shared.lines);
+    close(shared.fd0);
+    close(shared.fd1);
+    return identical;
+}
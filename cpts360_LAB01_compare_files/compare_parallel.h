@@ -0,0 +1,15 @@
+// Parallel version of compareFilesAt() for very large files, where one
+// reader cannot keep a striped disk array busy.
+#ifndef COMPARE_PARALLEL_INCLUDED
+#define COMPARE_PARALLEL_INCLUDED
+
+#include "compare_files.h" // for FileDiff
+
+// Same contract and same result as compareFilesAt(), but `nthreads`
+// threads compare disjoint ranges of the files with pread(2). A thread
+// that finds a difference stops the others from starting ranges past it,
+// and the lowest differing offset found is the one reported. Anything but
+// two regular files is handed to compareFilesAt().
+int compareFilesParallel(char *fname0, char *fname1, int nthreads, FileDiff *where);
+
+#endif // COMPARE_PARALLEL_INCLUDED
@@ -1,14 +1,125 @@
 #include <stdio.h>
+#include <stdlib.h> // for atoi() and atoll()
+#include <string.h> // for strcmp()
+#include <unistd.h> // for getopt()
+#include "compare_delta.h"
 #include "compare_files.h"
+#include "compare_many.h"
+#include "compare_parallel.h"
 #include "eprintf.h"
 
 
+// Prints every form of the command line and exits.
+static void usage(char *progname)
+{
+    eprintf_fail("syntax: %s [-g | -j N | -m | -r] [-l] {file0} {file1}\n"
+                 "        %s -a {file0} {file1} [file...]\n"
+                 "        %s -d json|bin [-b BYTES] {old} {new}\n", progname, progname, progname);
+}
+
+
+// Compares all of `fnames` at once and prints one line per class of
+// identical files, in order of each class's first file.
+static int printClasses(char *fnames[], int nfiles)
+{
+    int classOf[nfiles];
+    int nclasses = compareManyFiles(fnames, nfiles, classOf);
+
+    if (nclasses == 1) {
+        printf("files are identical\n");
+        return 0;
+    }
+    for (int c = 0; c < nclasses; c++) {
+        printf("class %d:", c + 1);
+        for (int i = 0; i < nfiles; i++)
+            if (classOf[i] == c)
+                printf(" %s", fnames[i]);
+        printf("\n");
+    }
+    return 0;
+}
+
+
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
-        eprintf_fail("syntax: %s {file0} {file1}\n", argv[0]);
-    if (compareFiles(argv[1], argv[2]))
+    int getcBaseline = 0;
+    int manyFiles = 0;
+    char *deltaFormat = NULL;
+    long long blockSize = DELTA_BLOCK_SIZE;
+    int locate = 0;
+    int nthreads = 1;
+    FileDiff where;
+    int identical;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ab:d:gj:lmr")) != -1) {
+        switch (opt) {
+        case 'a': // sort any number of files into classes of identical ones
+            manyFiles = 1;
+            break;
+        case 'b': // block size for -d
+            blockSize = atoll(optarg);
+            if (blockSize < 1)
+                eprintf_fail("%s: -b needs a positive block size\n", argv[0]);
+            break;
+        case 'd': // report the differing blocks, as "json" or "bin"
+            deltaFormat = optarg;
+            if (strcmp(deltaFormat, "json") != 0 && strcmp(deltaFormat, "bin") != 0)
+                eprintf_fail("%s: -d takes json or bin\n", argv[0]);
+            break;
+        case 'g': // byte-at-a-time baseline, for benchmarking
+            getcBaseline = 1;
+            break;
+        case 'j': // compare ranges of the files on this many threads
+            nthreads = atoi(optarg);
+            if (nthreads < 1)
+                eprintf_fail("%s: -j needs a positive thread count\n", argv[0]);
+            break;
+        case 'l': // report where the files first differ
+            locate = 1;
+            break;
+        case 'm': // always mmap() regular files
+            mmapMinSize = 0;
+            break;
+        case 'r': // never mmap(), always read()
+            mmapMinSize = -1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (deltaFormat) {
+        if (argc - optind != 2 || manyFiles || getcBaseline || locate || nthreads > 1)
+            usage(argv[0]);
+        Delta delta = compareDelta(argv[optind], argv[optind + 1], blockSize);
+        if (strcmp(deltaFormat, "json") == 0)
+            writeDeltaJson(stdout, &delta);
+        else
+            writeDeltaBinary(stdout, &delta);
+        freeDelta(&delta);
+        return 0;
+    }
+    if (manyFiles) {
+        if (argc - optind < 2 || getcBaseline || locate || nthreads > 1)
+            usage(argv[0]);
+        return printClasses(argv + optind, argc - optind);
+    }
+    if (argc - optind != 2 || (getcBaseline && (locate || nthreads > 1)))
+        usage(argv[0]);
+
+    if (getcBaseline)
+        identical = compareFilesGetc(argv[optind], argv[optind + 1]);
+    else if (nthreads > 1)
+        identical = compareFilesParallel(argv[optind], argv[optind + 1], nthreads,
+                                         locate ? &where : NULL);
+    else
+        identical = compareFilesAt(argv[optind], argv[optind + 1], locate ? &where : NULL);
+
+    if (identical)
         printf("files are identical\n");
+    else if (locate)
+        printf("files differ at byte %lld (line %lld, column %lld)\n",
+               where.offset, where.line, where.column);
     else
         printf("files differ\n");
     return 0;
@@ -0,0 +1,181 @@
+// Each helper has a plain C version and, on x86, SSE2 and AVX2 versions
+// that test 64 bytes per loop iteration: equal bytes compare to all-ones
+// lanes, and movemask turns a vector compare into one bit per byte, so
+// the first difference is the lowest clear bit and a newline count is a
+// population count. The AVX2 versions are compiled with a target
+// attribute and picked at startup, so one binary runs on any x86-64.
+#include <stdint.h> // for uint64_t
+#include <string.h> // for memcpy()
+
+#include "memdiff.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h> // for the SSE2 and AVX2 intrinsics
+#endif
+
+
+static size_t firstDifferenceScalar(const char *a, const char *b, size_t n)
+{
+    size_t i = 0;
+
+    // Skip equal 8-byte words, then find the byte within the word.
+    for (; i + 8 <= n; i += 8) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        if (wa != wb)
+            break;
+    }
+    for (; i < n; i++)
+        if (a[i] != b[i])
+            return i;
+    return n;
+}
+
+
+static size_t countNewlinesScalar(const char *p, size_t n, size_t *last)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == '\n') {
+            count++;
+            *last = i;
+        }
+    }
+    return count;
+}
+
+
+#if defined(HAVE_X86_SIMD) && defined(__SSE2__)
+static size_t firstDifferenceSSE2(const char *a, const char *b, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64) {
+        __m128i eq = _mm_set1_epi8(-1);
+        for (int j = 0; j < 64; j += 16) {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + i + j));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + i + j));
+            eq = _mm_and_si128(eq, _mm_cmpeq_epi8(va, vb));
+        }
+        if (_mm_movemask_epi8(eq) != 0xffff)
+            break; // the difference is somewhere in these 64 bytes
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        unsigned diff = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) ^ 0xffff;
+        if (diff)
+            return i + __builtin_ctz(diff);
+    }
+    return i + firstDifferenceScalar(a + i, b + i, n - i);
+}
+
+
+static size_t countNewlinesSSE2(const char *p, size_t n, size_t *last)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t count = 0, i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        if (mask) {
+            count += __builtin_popcount(mask);
+            *last = i + 31 - __builtin_clz(mask);
+        }
+    }
+    size_t tailLast;
+    size_t tail = countNewlinesScalar(p + i, n - i, &tailLast);
+    if (tail)
+        *last = i + tailLast;
+    return count + tail;
+}
+#endif
+
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static size_t firstDifferenceAVX2(const char *a, const char *b, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(a + i + 32));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(b + i + 32));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(a0, b0), _mm256_cmpeq_epi8(a1, b1));
+        if ((unsigned)_mm256_movemask_epi8(eq) != 0xffffffffu)
+            break; // the difference is somewhere in these 64 bytes
+    }
+    for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        unsigned diff = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+        if (diff)
+            return i + __builtin_ctz(diff);
+    }
+    return i + firstDifferenceScalar(a + i, b + i, n - i);
+}
+
+
+__attribute__((target("avx2,popcnt")))
+static size_t countNewlinesAVX2(const char *p, size_t n, size_t *last)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t count = 0, i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+        if (mask) {
+            count += __builtin_popcount(mask);
+            *last = i + 31 - __builtin_clz(mask);
+        }
+    }
+    size_t tailLast;
+    size_t tail = countNewlinesScalar(p + i, n - i, &tailLast);
+    if (tail)
+        *last = i + tailLast;
+    return count + tail;
+}
+#endif
+
+
+// The versions in use. They start as the best ones the compiler's target
+// guarantees and are upgraded at startup if the CPU can do better.
+#if defined(HAVE_X86_SIMD) && defined(__SSE2__)
+static size_t (*firstDifferenceImpl)(const char *, const char *, size_t) = firstDifferenceSSE2;
+static size_t (*countNewlinesImpl)(const char *, size_t, size_t *) = countNewlinesSSE2;
+#else
+static size_t (*firstDifferenceImpl)(const char *, const char *, size_t) = firstDifferenceScalar;
+static size_t (*countNewlinesImpl)(const char *, size_t, size_t *) = countNewlinesScalar;
+#endif
+
+#ifdef HAVE_X86_SIMD
+__attribute__((constructor))
+static void chooseImplementations(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        firstDifferenceImpl = firstDifferenceAVX2;
+        if (__builtin_cpu_supports("popcnt"))
+            countNewlinesImpl = countNewlinesAVX2;
+    }
+}
+#endif
+
+
+size_t firstDifference(const char *a, const char *b, size_t n)
+{
+    return firstDifferenceImpl(a, b, n);
+}
+
+
+size_t countNewlines(const char *p, size_t n, size_t *last)
+{
+    return countNewlinesImpl(p, n, last);
+}
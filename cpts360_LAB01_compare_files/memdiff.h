@@ -0,0 +1,16 @@
+// Vectorized helpers for locating differences: they use AVX2 when the
+// CPU has it, SSE2 on any other x86-64, and plain C everywhere else.
+#ifndef MEMDIFF_INCLUDED
+#define MEMDIFF_INCLUDED
+
+#include <stddef.h> // for size_t
+
+// Returns the index of the first byte where `a` and `b` differ, or `n`
+// if their first `n` bytes are the same.
+size_t firstDifference(const char *a, const char *b, size_t n);
+
+// Returns the number of '\n' bytes among the first `n` bytes of `p`. If
+// there is at least one, the index of the last is stored in `*last`.
+size_t countNewlines(const char *p, size_t n, size_t *last);
+
+#endif // MEMDIFF_INCLUDED